@@ -0,0 +1,159 @@
+#ifndef SYNTHETIC_DATA_HPP
+#define SYNTHETIC_DATA_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+struct SyntheticCity {
+    std::string name;
+    double lat = 0.0;
+    double lon = 0.0;
+    int temp = 0;
+    std::string condition;
+    int wind = 0;
+    int humidity = 0;
+    int aqi = 0;
+    double rain = 0.0;
+    int windDir = 0;
+};
+
+struct SyntheticDataset {
+    std::vector<SyntheticCity> cities;
+    std::vector<std::pair<size_t, size_t>> edges;
+};
+
+// Deterministic generator for benchmark datasets: cities are scattered over a
+// lat/lon box and joined into a random geometric graph, where each edge links a
+// city to another one from the same or an adjacent grid cell.
+class SyntheticData {
+public:
+    static SyntheticDataset generate(size_t cityCount, size_t edgeCount, uint64_t seed = 42) {
+        SyntheticDataset data;
+        std::mt19937_64 rng(seed);
+        std::uniform_real_distribution<double> latDist(minLat, maxLat);
+        std::uniform_real_distribution<double> lonDist(minLon, maxLon);
+        std::uniform_int_distribution<int> tempDist(-5, 45);
+        std::uniform_int_distribution<int> windDist(0, 40);
+        std::uniform_int_distribution<int> humidityDist(10, 95);
+        std::uniform_int_distribution<int> aqiDist(10, 400);
+        std::uniform_int_distribution<int> dirDist(0, 359);
+        std::uniform_real_distribution<double> rainDist(0.0, 1.0);
+        const char* conditions[] = {"Sunny", "Cloudy", "Rainy", "Windy", "Hot", "Snowy"};
+
+        data.cities.reserve(cityCount);
+        std::vector<std::string> names = nameCorpus(cityCount, rng);
+        for (size_t i = 0; i < cityCount; i++) {
+            SyntheticCity city;
+            city.name = names[i];
+            city.lat = latDist(rng);
+            city.lon = lonDist(rng);
+            city.temp = tempDist(rng);
+            city.condition = conditions[rng() % 6];
+            city.wind = windDist(rng);
+            city.humidity = humidityDist(rng);
+            city.aqi = aqiDist(rng);
+            double r = rainDist(rng);
+            city.rain = r < 0.7 ? 0.0 : std::round((r - 0.7) * 400.0) / 10.0;
+            city.windDir = dirDist(rng);
+            data.cities.push_back(std::move(city));
+        }
+
+        if (cityCount < 2) return data;
+
+        // Cells sized so the average cell holds about four cities.
+        const size_t side = std::max<size_t>(1, static_cast<size_t>(std::sqrt(static_cast<double>(cityCount) / 4.0)));
+        std::vector<std::vector<size_t>> cells(side * side);
+        auto cellOf = [&](const SyntheticCity& c) {
+            size_t x = std::min(side - 1, static_cast<size_t>((c.lat - minLat) / (maxLat - minLat) * side));
+            size_t y = std::min(side - 1, static_cast<size_t>((c.lon - minLon) / (maxLon - minLon) * side));
+            return std::make_pair(x, y);
+        };
+        for (size_t i = 0; i < cityCount; i++) {
+            auto cell = cellOf(data.cities[i]);
+            cells[cell.first * side + cell.second].push_back(i);
+        }
+
+        std::unordered_set<uint64_t> seen;
+        seen.reserve(edgeCount * 2);
+        data.edges.reserve(edgeCount);
+        size_t attempts = 0;
+        while (data.edges.size() < edgeCount && attempts < edgeCount * 20) {
+            attempts++;
+            size_t a = data.edges.size() < cityCount ? data.edges.size() : rng() % cityCount;
+            auto cell = cellOf(data.cities[a]);
+            long dx = static_cast<long>(rng() % 3) - 1;
+            long dy = static_cast<long>(rng() % 3) - 1;
+            long x = static_cast<long>(cell.first) + dx;
+            long y = static_cast<long>(cell.second) + dy;
+            if (x < 0 || y < 0 || x >= static_cast<long>(side) || y >= static_cast<long>(side)) continue;
+            const std::vector<size_t>& bucket = cells[static_cast<size_t>(x) * side + static_cast<size_t>(y)];
+            if (bucket.empty()) continue;
+            size_t b = bucket[rng() % bucket.size()];
+            if (a == b) continue;
+            uint64_t key = (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+            if (!seen.insert(key).second) continue;
+            data.edges.push_back({a, b});
+        }
+        return data;
+    }
+
+    static bool writeCitiesCsv(const SyntheticDataset& data, const std::string& path) {
+        std::ofstream file(path);
+        if (!file.is_open()) return false;
+        file << "City,Lat,Lon,Temp,Condition,Wind,Humidity,AQI,Rain,WindDir\n";
+        file.setf(std::ios::fixed);
+        file.precision(4);
+        for (const SyntheticCity& c : data.cities) {
+            file << c.name << ',' << c.lat << ',' << c.lon << ',' << c.temp << ',' << c.condition << ','
+                 << c.wind << ',' << c.humidity << ',' << c.aqi << ',' << c.rain << ',' << c.windDir << '\n';
+        }
+        return file.good();
+    }
+
+    // Route network file for the generated graph; risk and distance are left
+    // empty so the engine derives them from the two cities.
+    static bool writeRoutesCsv(const SyntheticDataset& data, const std::string& path) {
+        std::ofstream file(path);
+        if (!file.is_open()) return false;
+        file << "From,To,Risk,DistanceKm\n";
+        for (const auto& edge : data.edges) {
+            file << data.cities[edge.first].name << ',' << data.cities[edge.second].name << ",,\n";
+        }
+        return file.good();
+    }
+
+private:
+    static constexpr double minLat = 23.5;
+    static constexpr double maxLat = 37.0;
+    static constexpr double minLon = 61.0;
+    static constexpr double maxLon = 77.5;
+
+    // Pakistani-sounding place names built from syllables; a numeric suffix is
+    // added once the plain combinations run out so every name stays unique.
+    static std::vector<std::string> nameCorpus(size_t count, std::mt19937_64& rng) {
+        const char* heads[] = {"Ab", "Bah", "Cha", "Dera", "Fai", "Guj", "Hyd", "Isl", "Jhe", "Kar",
+                               "Lah", "Man", "Now", "Osh", "Pes", "Que", "Raw", "Sar", "Tak", "Wah"};
+        const char* middles[] = {"a", "al", "ar", "ba", "di", "ga", "ka", "ma", "ra", "sa"};
+        const char* tails[] = {"abad", "pur", "kot", "garh", "wala", "nagar", "shah", "dara", "khel", "pura"};
+        std::vector<std::string> names;
+        names.reserve(count);
+        std::unordered_set<std::string> used;
+        used.reserve(count * 2);
+        size_t suffix = 1;
+        while (names.size() < count) {
+            std::string name = std::string(heads[rng() % 20]) + middles[rng() % 10] + tails[rng() % 10];
+            if (used.size() >= 1500) name += " " + std::to_string(suffix++);
+            if (used.insert(name).second) names.push_back(name);
+        }
+        return names;
+    }
+};
+
+#endif
@@ -0,0 +1,372 @@
+#include "EngineSnapshot.hpp"
+#include "ObservationStore.hpp"
+#include "RequestArena.hpp"
+#include "SyntheticData.hpp"
+#include "WeatherEngine.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <queue>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+struct BenchResult {
+    std::string name;
+    size_t iterations = 0;
+    double nsPerOp = 0.0;
+    double totalMs = 0.0;
+};
+
+struct BenchOptions {
+    std::vector<size_t> scales = {1000, 10000, 100000};
+    size_t edgesPerCity = 3;
+    size_t spatialPoints = 1000000;
+    double budgetMs = 300.0;
+    std::string outPath;
+};
+
+size_t sink = 0;
+
+// Runs op until the time budget is spent (at least once, at most maxIterations).
+template <typename Op>
+BenchResult measure(const std::string& name, double budgetMs, size_t maxIterations, Op op) {
+    using Clock = std::chrono::steady_clock;
+    BenchResult result;
+    result.name = name;
+    Clock::time_point start = Clock::now();
+    double elapsedMs = 0.0;
+    while (result.iterations < maxIterations && (result.iterations == 0 || elapsedMs < budgetMs)) {
+        op(result.iterations);
+        result.iterations++;
+        elapsedMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+    result.totalMs = elapsedMs;
+    result.nsPerOp = elapsedMs * 1e6 / static_cast<double>(result.iterations);
+    return result;
+}
+
+std::string jsonEscape(const std::string& value) {
+    std::string out;
+    for (char ch : value) {
+        if (ch == '"' || ch == '\\') out.push_back('\\');
+        out.push_back(ch);
+    }
+    return out;
+}
+
+std::vector<size_t> parseScales(const std::string& text) {
+    std::vector<size_t> scales;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (item.empty()) continue;
+        size_t scale = static_cast<size_t>(std::strtoull(item.c_str(), nullptr, 10));
+        // Every scale needs at least one city to pick queries from.
+        if (scale == 0) {
+            std::cerr << "--scales entries must be positive, got '" << item << "'" << std::endl;
+            return {};
+        }
+        scales.push_back(scale);
+    }
+    return scales;
+}
+
+bool parseOptions(int argc, char** argv, BenchOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto next = [&]() -> std::string { return i + 1 < argc ? argv[++i] : ""; };
+        if (arg == "--scales") {
+            options.scales = parseScales(next());
+        } else if (arg == "--edges-per-city") {
+            options.edgesPerCity = static_cast<size_t>(std::strtoull(next().c_str(), nullptr, 10));
+        } else if (arg == "--spatial-points") {
+            options.spatialPoints = static_cast<size_t>(std::strtoull(next().c_str(), nullptr, 10));
+        } else if (arg == "--budget-ms") {
+            options.budgetMs = std::strtod(next().c_str(), nullptr);
+        } else if (arg == "--out") {
+            options.outPath = next();
+        } else {
+            std::cerr << "usage: weather_engine_bench [--scales 1000,10000] [--edges-per-city 3]"
+                         " [--spatial-points 1000000] [--budget-ms 300] [--out results.json]" << std::endl;
+            return false;
+        }
+    }
+    return !options.scales.empty();
+}
+
+std::vector<BenchResult> runScale(size_t cityCount, const BenchOptions& options, size_t& edgeCount) {
+    SyntheticDataset data = SyntheticData::generate(cityCount, cityCount * options.edgesPerCity);
+    edgeCount = data.edges.size();
+    const std::string csvPath = "weather_bench_" + std::to_string(cityCount) + ".csv";
+    SyntheticData::writeCitiesCsv(data, csvPath);
+
+    std::vector<BenchResult> results;
+    results.push_back(measure("loadCitiesFromCsv", options.budgetMs, 5, [&](size_t) {
+        WeatherEngine fresh;
+        std::string error;
+        fresh.loadCitiesFromCsv(csvPath, &error);
+    }));
+    results.push_back(measure("loadCitiesFromCsvMapped", options.budgetMs, 5, [&](size_t) {
+        WeatherEngine fresh;
+        CsvLoadReport report;
+        fresh.loadCitiesFromCsvMapped(csvPath, report);
+        sink += report.rowsLoaded;
+    }));
+
+    WeatherEngine engine;
+    std::string loadError;
+    engine.loadCitiesFromCsv(csvPath, &loadError);
+
+    results.push_back(measure("addRoute", options.budgetMs, 1, [&](size_t) {
+        for (const auto& edge : data.edges) {
+            engine.addRoute(data.cities[edge.first].name, data.cities[edge.second].name);
+        }
+    }));
+    results.back().iterations = std::max<size_t>(1, data.edges.size());
+    results.back().nsPerOp /= static_cast<double>(results.back().iterations);
+
+    const std::string routesPath = "weather_bench_" + std::to_string(cityCount) + ".routes.csv";
+    SyntheticData::writeRoutesCsv(data, routesPath);
+    {
+        WeatherEngine bulk;
+        CsvLoadReport report;
+        bulk.loadCitiesFromCsvMapped(csvPath, report);
+        results.push_back(measure("loadRoutesFromCsv", options.budgetMs, 1, [&](size_t) {
+            CsvLoadReport routeReport;
+            bulk.loadRoutesFromCsv(routesPath, routeReport);
+            sink += routeReport.rowsLoaded;
+        }));
+        results.back().iterations = std::max<size_t>(1, data.edges.size());
+        results.back().nsPerOp /= static_cast<double>(results.back().iterations);
+    }
+    std::remove(routesPath.c_str());
+    std::remove(csvPath.c_str());
+
+    for (const SyntheticCity& city : data.cities) {
+        if (city.temp >= 40) engine.addAlert(9, "Heat advisory: high temperature trend", city.name);
+        if (city.aqi >= 300) engine.addAlert(8, "Air quality warning: reduce outdoor exposure", city.name);
+    }
+
+    const std::string snapshotPath = "weather_bench_" + std::to_string(cityCount) + ".snap";
+    results.push_back(measure("EngineSnapshot::save", options.budgetMs, 5, [&](size_t) {
+        EngineSnapshot::save(engine, snapshotPath);
+    }));
+    results.push_back(measure("EngineSnapshot::load", options.budgetMs, 5, [&](size_t) {
+        WeatherEngine restored;
+        sink += EngineSnapshot::load(restored, snapshotPath) ? 1 : 0;
+    }));
+    std::remove(snapshotPath.c_str());
+
+    std::mt19937_64 rng(7);
+    std::vector<size_t> picks(4096);
+    for (size_t& pick : picks) pick = rng() % data.cities.size();
+    auto cityName = [&](size_t i) -> const std::string& { return data.cities[picks[i % picks.size()]].name; };
+
+    results.push_back(measure("getCity", options.budgetMs, 1000000, [&](size_t i) {
+        City city;
+        sink += engine.getCity(cityName(i), city) ? city.hourlyData.size() : 0;
+    }));
+    results.push_back(measure("viewCity", options.budgetMs, 1000000, [&](size_t i) {
+        CityView view = engine.viewCity(cityName(i));
+        sink += view ? view.series(SeriesKind::Hourly).size() : 0;
+    }));
+    results.push_back(measure("getAllCities", options.budgetMs, 100, [&](size_t) {
+        sink += engine.getAllCities().size();
+    }));
+    results.push_back(measure("citiesByName", options.budgetMs, 100, [&](size_t) {
+        sink += engine.citiesByName().size();
+    }));
+
+    results.push_back(measure("autocomplete", options.budgetMs, 1000000, [&](size_t i) {
+        const std::string& name = cityName(i);
+        sink += engine.autocomplete(name.substr(0, 1 + i % 3), 8).size();
+    }));
+
+    results.push_back(measure("shortestRouteBfs", options.budgetMs, 100000, [&](size_t i) {
+        sink += engine.shortestRouteBfs(cityName(i), cityName(i + 1)).size();
+    }));
+
+    results.push_back(measure("safestRouteDijkstra", options.budgetMs, 100000, [&](size_t i) {
+        sink += engine.safestRouteDijkstra(cityName(i), cityName(i + 1)).path.size();
+    }));
+
+    results.push_back(measure("safestRouteOnDay", options.budgetMs, 100000, [&](size_t i) {
+        sink += engine.safestRouteOnDay(cityName(i), cityName(i + 1), static_cast<int>(i % WeatherEngine::forecastDays)).path.size();
+    }));
+
+    // Whole-graph expansion from one city, which answers what one
+    // safestRouteDijkstra call per destination would.
+    std::vector<ReachableCity> reached;
+    results.push_back(measure("reachableCities", options.budgetMs, 100000, [&](size_t i) {
+        engine.reachableCities(cityName(i), std::numeric_limits<int>::max(), std::numeric_limits<double>::infinity(), reached);
+        sink += reached.size();
+    }));
+
+    results.push_back(measure("getTopAlerts", options.budgetMs, 100000, [&](size_t) {
+        sink += engine.getTopAlerts(5).size();
+    }));
+
+    results.push_back(measure("getHottestCities", options.budgetMs, 100000, [&](size_t) {
+        sink += engine.getHottestCities(5).size();
+    }));
+    results.push_back(measure("hottestCities", options.budgetMs, 100000, [&](size_t) {
+        sink += engine.hottestCities(5).size();
+    }));
+    results.push_back(measure("hottestCities.arena", options.budgetMs, 100000, [&](size_t) {
+        RequestArena::Scope arena;
+        sink += engine.hottestCities(5, arena.resource()).size();
+    }));
+
+    // The same whole-day hourly aggregate, once walking every City's own
+    // vector and once through the columnar store.
+    std::vector<City> allCities = engine.getAllCities();
+    results.push_back(measure("seriesStats.perCityVectors", options.budgetMs, 1000, [&](size_t) {
+        SeriesReduction total;
+        for (const City& city : allCities) {
+            SeriesKernels::reduceScalar(city.hourlyData.data(), city.hourlyData.size(), total);
+        }
+        sink += static_cast<size_t>(total.max - total.min) + static_cast<size_t>(total.sum & 0xff);
+    }));
+    results.push_back(measure("seriesStats.columnar", options.budgetMs, 1000, [&](size_t) {
+        sink += engine.seriesStats(SeriesKind::Hourly, 0, 24, 1, {}).samples;
+    }));
+    results.push_back(measure("seriesStats.percentiles", options.budgetMs, 1000, [&](size_t) {
+        sink += engine.seriesStats(SeriesKind::Hourly, 0, 24).percentiles.size();
+    }));
+    results.push_back(measure("seriesStats.movingAverage", options.budgetMs, 1000, [&](size_t) {
+        sink += engine.seriesStats(SeriesKind::Monthly, 0, 30, 7, {}).samples;
+    }));
+
+    // A year of hourly readings for up to 64 cities, then reads served from
+    // the rollups and from the delta-encoded chunks.
+    ObservationStore history;
+    const size_t historyCities = std::min<size_t>(64, data.cities.size());
+    const int64_t yearStart = 1704067200;
+    results.push_back(measure("ObservationStore::append", options.budgetMs, 1, [&](size_t) {
+        for (int64_t hour = 0; hour < 24 * 365; hour++) {
+            for (size_t c = 0; c < historyCities; c++) {
+                history.append(data.cities[c].name, yearStart + hour * 3600, data.cities[c].temp + static_cast<int32_t>(hour % 7));
+            }
+        }
+    }));
+    results.back().iterations = historyCities * 24 * 365;
+    results.back().nsPerOp /= static_cast<double>(results.back().iterations);
+    results.push_back(measure("ObservationStore::windows", options.budgetMs, 100000, [&](size_t i) {
+        ObservedWindows observed;
+        history.windows(data.cities[i % historyCities].name, observed);
+        sink += observed.hourly.size();
+    }));
+    results.push_back(measure("ObservationStore::range.day", options.budgetMs, 100000, [&](size_t i) {
+        int64_t from = yearStart + static_cast<int64_t>(i % 364) * 86400;
+        sink += history.range(data.cities[i % historyCities].name, from, from + 86400).size();
+    }));
+    return results;
+}
+
+// The spatial index on its own, so it can be measured at sizes where building
+// a whole engine would dominate. The linear scans are the "no index" baseline.
+std::vector<BenchResult> runSpatial(size_t pointCount, const BenchOptions& options) {
+    std::vector<BenchResult> results;
+    if (pointCount == 0) return results;
+    std::mt19937_64 rng(11);
+    std::uniform_real_distribution<double> latDist(23.5, 37.0);
+    std::uniform_real_distribution<double> lonDist(61.0, 77.5);
+    std::vector<double> lats(pointCount);
+    std::vector<double> lons(pointCount);
+    for (size_t i = 0; i < pointCount; i++) {
+        lats[i] = latDist(rng);
+        lons[i] = lonDist(rng);
+    }
+
+    SpatialIndex index;
+    results.push_back(measure("SpatialIndex::build", options.budgetMs, 3, [&](size_t) {
+        index.build(lats, lons);
+        sink += index.size();
+    }));
+    results.push_back(measure("SpatialIndex::nearest.k10", options.budgetMs, 1000000, [&](size_t i) {
+        sink += index.nearest(lats[i % pointCount] + 0.01, lons[i % pointCount], 10).size();
+    }));
+    results.push_back(measure("linearScan.nearest.k10", options.budgetMs, 1000, [&](size_t i) {
+        double lat = lats[i % pointCount] + 0.01;
+        double lon = lons[i % pointCount];
+        std::priority_queue<std::pair<double, size_t>> best;
+        for (size_t p = 0; p < pointCount; p++) {
+            double dLat = lats[p] - lat;
+            double dLon = (lons[p] - lon) * std::cos(lat * 3.14159265358979323846 / 180.0);
+            best.push({dLat * dLat + dLon * dLon, p});
+            if (best.size() > 10) best.pop();
+        }
+        sink += best.size();
+    }));
+    // A city-sized viewport (~0.1 deg) and a regional one (~2 deg).
+    for (double span : {0.1, 2.0}) {
+        const std::string label = span < 1 ? "small" : "large";
+        std::vector<uint32_t> ids;
+        results.push_back(measure("SpatialIndex::withinBox." + label, options.budgetMs, 1000000, [&](size_t i) {
+            ids.clear();
+            double lat = lats[i % pointCount];
+            double lon = lons[i % pointCount];
+            index.withinBox(lat - span / 2, lat + span / 2, lon - span / 2, lon + span / 2, ids);
+            sink += ids.size();
+        }));
+        results.push_back(measure("linearScan.withinBox." + label, options.budgetMs, 1000, [&](size_t i) {
+            double lat = lats[i % pointCount];
+            double lon = lons[i % pointCount];
+            size_t count = 0;
+            for (size_t p = 0; p < pointCount; p++) {
+                count += std::abs(lats[p] - lat) <= span / 2 && std::abs(lons[p] - lon) <= span / 2;
+            }
+            sink += count;
+        }));
+    }
+    return results;
+}
+
+std::string resultsJson(const std::vector<BenchResult>& results) {
+    std::ostringstream json;
+    json << "[";
+    for (size_t i = 0; i < results.size(); i++) {
+        json << "{\"name\":\"" << jsonEscape(results[i].name) << "\","
+             << "\"iterations\":" << results[i].iterations << ","
+             << "\"ns_per_op\":" << static_cast<long long>(results[i].nsPerOp + 0.5) << ","
+             << "\"total_ms\":" << results[i].totalMs << "}";
+        if (i + 1 < results.size()) json << ",";
+    }
+    json << "]";
+    return json.str();
+}
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    if (!parseOptions(argc, argv, options)) return 2;
+
+    std::ostringstream json;
+    json << "{\"benchmark\":\"weather_engine\",\"unit\":\"ns_per_op\",\"scales\":[";
+    for (size_t s = 0; s < options.scales.size(); s++) {
+        size_t edgeCount = 0;
+        std::vector<BenchResult> results = runScale(options.scales[s], options, edgeCount);
+        json << "{\"cities\":" << options.scales[s] << ",\"edges\":" << edgeCount
+             << ",\"results\":" << resultsJson(results) << "}";
+        if (s + 1 < options.scales.size()) json << ",";
+        std::cerr << "scale " << options.scales[s] << " done" << std::endl;
+    }
+    json << "],\"spatial\":{\"points\":" << options.spatialPoints
+         << ",\"results\":" << resultsJson(runSpatial(options.spatialPoints, options)) << "}";
+    json << ",\"checksum\":" << sink << "}";
+
+    if (!options.outPath.empty()) {
+        std::ofstream out(options.outPath);
+        out << json.str() << "\n";
+    }
+    std::cout << json.str() << std::endl;
+    return 0;
+}
@@ -0,0 +1,400 @@
+#include "Metrics.hpp"
+#include "NetworkUtils.hpp"
+#include "SyntheticData.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#endif
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+enum Endpoint { Weather, Route, Suggest, Alerts, EndpointCount };
+const char* endpointNames[] = {"/api/weather", "/api/route", "/api/suggest", "/api/alerts"};
+
+struct LoadOptions {
+    std::string host = "127.0.0.1";
+    int port = 8080;
+    int connections = 8;
+    double durationSec = 10.0;
+    double warmupSec = 1.0;
+    double targetRps = 0.0;
+    bool keepAlive = true;
+    int mix[EndpointCount] = {50, 20, 20, 10};
+    std::vector<std::string> cities;
+    std::string jsonPath;
+    std::string writeDataset;
+    std::string writeRoutes;
+    size_t datasetCities = 10000;
+};
+
+struct WorkerStats {
+    LatencyHistogram latency[EndpointCount];
+    LatencyHistogram all;
+    uint64_t ok = 0;
+    uint64_t httpErrors = 0;
+    uint64_t ioErrors = 0;
+    uint64_t reconnects = 0;
+};
+
+std::atomic<bool> measuring {false};
+std::atomic<bool> stopping {false};
+
+bool isLoopback(const std::string& host) {
+    return host == "localhost" || host.rfind("127.", 0) == 0;
+}
+
+SOCKET connectTo(const LoadOptions& options) {
+    SOCKET sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock == INVALID_SOCKET) return INVALID_SOCKET;
+    sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<unsigned short>(options.port));
+    inet_pton(AF_INET, options.host == "localhost" ? "127.0.0.1" : options.host.c_str(), &addr.sin_addr);
+    if (connect(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == SOCKET_ERROR) {
+        closesocket(sock);
+        return INVALID_SOCKET;
+    }
+    int noDelay = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+    return sock;
+}
+
+bool sendAll(SOCKET sock, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        int n = send(sock, data.data() + sent, static_cast<int>(data.size() - sent), 0);
+        if (n <= 0) return false;
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Reads one response; returns the status code or 0 on I/O failure. Sets
+// serverClosed when the server asked for (or performed) a close.
+int readResponse(SOCKET sock, std::string& buffer, bool& serverClosed) {
+    buffer.clear();
+    char chunk[16384];
+    size_t headerEnd = std::string::npos;
+    while (headerEnd == std::string::npos) {
+        int n = recv(sock, chunk, sizeof(chunk), 0);
+        if (n <= 0) return 0;
+        buffer.append(chunk, static_cast<size_t>(n));
+        headerEnd = buffer.find("\r\n\r\n");
+    }
+
+    int status = std::atoi(buffer.c_str() + buffer.find(' ') + 1);
+    size_t contentLength = 0;
+    size_t lengthAt = buffer.find("Content-Length:");
+    if (lengthAt != std::string::npos && lengthAt < headerEnd) {
+        contentLength = static_cast<size_t>(std::strtoull(buffer.c_str() + lengthAt + 15, nullptr, 10));
+    }
+    size_t closeAt = buffer.find("Connection: close");
+    serverClosed = closeAt != std::string::npos && closeAt < headerEnd;
+
+    size_t needed = headerEnd + 4 + contentLength;
+    while (buffer.size() < needed) {
+        int n = recv(sock, chunk, sizeof(chunk), 0);
+        if (n <= 0) return 0;
+        buffer.append(chunk, static_cast<size_t>(n));
+    }
+    return status;
+}
+
+std::string urlEncode(const std::string& value) {
+    std::ostringstream out;
+    for (unsigned char ch : value) {
+        if (std::isalnum(ch) || ch == '-' || ch == '_' || ch == '.') {
+            out << ch;
+        } else {
+            out << '%' << std::uppercase << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(ch)
+                << std::dec;
+        }
+    }
+    return out.str();
+}
+
+std::string buildTarget(Endpoint endpoint, const std::vector<std::string>& cities, std::mt19937_64& rng) {
+    const std::string& a = cities[rng() % cities.size()];
+    switch (endpoint) {
+        case Weather: return "/api/weather?city=" + urlEncode(a);
+        case Route: {
+            const std::string& b = cities[rng() % cities.size()];
+            return "/api/route?from=" + urlEncode(a) + "&to=" + urlEncode(b) + (rng() % 4 == 0 ? "&mode=bfs" : "&mode=safe");
+        }
+        case Suggest: return "/api/suggest?q=" + urlEncode(a.substr(0, 1 + rng() % 3));
+        default: return "/api/alerts?k=5";
+    }
+}
+
+void runWorker(const LoadOptions& options, int workerId, WorkerStats& stats) {
+    std::mt19937_64 rng(1000 + static_cast<uint64_t>(workerId));
+    int mixTotal = 0;
+    for (int weight : options.mix) mixTotal += weight;
+
+    const double perWorkerRps = options.targetRps / options.connections;
+    const auto interval = perWorkerRps > 0
+        ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / perWorkerRps))
+        : Clock::duration::zero();
+    Clock::time_point nextSend = Clock::now();
+
+    SOCKET sock = INVALID_SOCKET;
+    std::string response;
+    while (!stopping.load(std::memory_order_relaxed)) {
+        int pick = static_cast<int>(rng() % static_cast<uint64_t>(mixTotal));
+        Endpoint endpoint = Weather;
+        for (int e = 0; e < EndpointCount; e++) {
+            if (pick < options.mix[e]) { endpoint = static_cast<Endpoint>(e); break; }
+            pick -= options.mix[e];
+        }
+        std::string request = "GET " + buildTarget(endpoint, options.cities, rng) + " HTTP/1.1\r\n"
+                              "Host: localhost\r\n"
+                              "Connection: " + std::string(options.keepAlive ? "keep-alive" : "close") + "\r\n\r\n";
+
+        // Open-loop pacing: latency is measured from the intended send time, so
+        // a stalled server is charged for the requests it held back.
+        Clock::time_point intended = Clock::now();
+        if (interval != Clock::duration::zero()) {
+            intended = nextSend;
+            nextSend += interval;
+            if (intended > Clock::now()) std::this_thread::sleep_until(intended);
+        }
+
+        if (sock == INVALID_SOCKET) {
+            sock = connectTo(options);
+            if (sock == INVALID_SOCKET) {
+                if (measuring.load(std::memory_order_relaxed)) stats.ioErrors++;
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                continue;
+            }
+            if (measuring.load(std::memory_order_relaxed)) stats.reconnects++;
+        }
+
+        bool serverClosed = false;
+        int status = sendAll(sock, request) ? readResponse(sock, response, serverClosed) : 0;
+        uint64_t nanos = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - intended).count());
+
+        if (measuring.load(std::memory_order_relaxed)) {
+            if (status == 0) {
+                stats.ioErrors++;
+            } else {
+                stats.latency[endpoint].record(nanos);
+                stats.all.record(nanos);
+                if (status >= 200 && status < 400) stats.ok++;
+                else stats.httpErrors++;
+            }
+        }
+        if (status == 0 || serverClosed || !options.keepAlive) {
+            closesocket(sock);
+            sock = INVALID_SOCKET;
+        }
+    }
+    if (sock != INVALID_SOCKET) closesocket(sock);
+}
+
+// Pulls the city list from /api/cities so every request targets a real city.
+std::vector<std::string> fetchCities(const LoadOptions& options) {
+    std::vector<std::string> cities;
+    SOCKET sock = connectTo(options);
+    if (sock == INVALID_SOCKET) return cities;
+    std::string response;
+    bool serverClosed = false;
+    if (sendAll(sock, "GET /api/cities HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n") &&
+        readResponse(sock, response, serverClosed) == 200) {
+        size_t at = 0;
+        while ((at = response.find("\"name\":\"", at)) != std::string::npos) {
+            at += 8;
+            size_t end = response.find('"', at);
+            if (end == std::string::npos) break;
+            cities.push_back(response.substr(at, end - at));
+            at = end;
+        }
+    }
+    closesocket(sock);
+    return cities;
+}
+
+bool parseMix(const std::string& text, int mix[EndpointCount]) {
+    for (int e = 0; e < EndpointCount; e++) mix[e] = 0;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        size_t eq = item.find('=');
+        if (eq == std::string::npos) return false;
+        std::string name = "/api/" + item.substr(0, eq);
+        int weight = std::atoi(item.c_str() + eq + 1);
+        bool known = false;
+        for (int e = 0; e < EndpointCount; e++) {
+            if (name == endpointNames[e]) { mix[e] = weight; known = true; }
+        }
+        if (!known || weight < 0) return false;
+    }
+    int total = 0;
+    for (int e = 0; e < EndpointCount; e++) total += mix[e];
+    return total > 0;
+}
+
+bool parseOptions(int argc, char** argv, LoadOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto next = [&]() -> std::string { return i + 1 < argc ? argv[++i] : ""; };
+        if (arg == "--host") options.host = next();
+        else if (arg == "--port") options.port = std::atoi(next().c_str());
+        else if (arg == "--connections") options.connections = std::max(1, std::atoi(next().c_str()));
+        else if (arg == "--duration") options.durationSec = std::strtod(next().c_str(), nullptr);
+        else if (arg == "--warmup") options.warmupSec = std::strtod(next().c_str(), nullptr);
+        else if (arg == "--rps") options.targetRps = std::strtod(next().c_str(), nullptr);
+        else if (arg == "--keep-alive") options.keepAlive = next() != "off";
+        else if (arg == "--json") options.jsonPath = next();
+        else if (arg == "--write-dataset") options.writeDataset = next();
+        else if (arg == "--write-routes") options.writeRoutes = next();
+        else if (arg == "--cities") options.datasetCities = static_cast<size_t>(std::strtoull(next().c_str(), nullptr, 10));
+        else if (arg == "--mix") {
+            if (!parseMix(next(), options.mix)) {
+                std::cerr << "--mix expects e.g. weather=50,route=20,suggest=20,alerts=10" << std::endl;
+                return false;
+            }
+        } else {
+            std::cerr << "usage: weather_loadgen [--port 8080] [--connections 8] [--duration 10] [--warmup 1]\n"
+                         "                       [--rps 0] [--keep-alive on|off] [--json out.json]\n"
+                         "                       [--mix weather=50,route=20,suggest=20,alerts=10]\n"
+                         "       weather_loadgen --write-dataset cities.csv [--write-routes routes.csv] [--cities 10000]"
+                      << std::endl;
+            return false;
+        }
+    }
+    if (!isLoopback(options.host)) {
+        std::cerr << "weather_loadgen only targets loopback addresses" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+double ms(uint64_t nanos) {
+    return static_cast<double>(nanos) / 1e6;
+}
+}
+
+int main(int argc, char** argv) {
+    LoadOptions options;
+    if (!parseOptions(argc, argv, options)) return 2;
+
+    if (!options.writeDataset.empty()) {
+        SyntheticDataset data = SyntheticData::generate(options.datasetCities, options.datasetCities * 3);
+        if (!SyntheticData::writeCitiesCsv(data, options.writeDataset)) {
+            std::cerr << "Could not write " << options.writeDataset << std::endl;
+            return 1;
+        }
+        std::cout << "Wrote " << data.cities.size() << " cities to " << options.writeDataset << std::endl;
+        if (!options.writeRoutes.empty()) {
+            if (!SyntheticData::writeRoutesCsv(data, options.writeRoutes)) {
+                std::cerr << "Could not write " << options.writeRoutes << std::endl;
+                return 1;
+            }
+            std::cout << "Wrote " << data.edges.size() << " routes to " << options.writeRoutes << std::endl;
+        }
+        return 0;
+    }
+
+    if (!SimpleServer::initNetwork()) return 1;
+    options.cities = fetchCities(options);
+    if (options.cities.empty()) {
+        std::cerr << "Could not fetch /api/cities from " << options.host << ":" << options.port << std::endl;
+        SimpleServer::cleanupNetwork();
+        return 1;
+    }
+
+    std::vector<std::unique_ptr<WorkerStats>> stats;
+    std::vector<std::thread> workers;
+    for (int i = 0; i < options.connections; i++) {
+        stats.push_back(std::make_unique<WorkerStats>());
+        workers.emplace_back(runWorker, std::cref(options), i, std::ref(*stats.back()));
+    }
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(options.warmupSec));
+    measuring = true;
+    Clock::time_point started = Clock::now();
+    std::this_thread::sleep_for(std::chrono::duration<double>(options.durationSec));
+    measuring = false;
+    double elapsed = std::chrono::duration<double>(Clock::now() - started).count();
+    stopping = true;
+    for (std::thread& worker : workers) worker.join();
+    SimpleServer::cleanupNetwork();
+
+    HistogramSnapshot all;
+    HistogramSnapshot perEndpoint[EndpointCount];
+    uint64_t ok = 0, httpErrors = 0, ioErrors = 0, reconnects = 0;
+    for (const auto& s : stats) {
+        s->all.addTo(all.counts, all.count, all.sum);
+        for (int e = 0; e < EndpointCount; e++) {
+            s->latency[e].addTo(perEndpoint[e].counts, perEndpoint[e].count, perEndpoint[e].sum);
+        }
+        ok += s->ok;
+        httpErrors += s->httpErrors;
+        ioErrors += s->ioErrors;
+        reconnects += s->reconnects;
+    }
+
+    std::ostringstream json;
+    json << "{\"connections\":" << options.connections
+         << ",\"keep_alive\":" << (options.keepAlive ? "true" : "false")
+         << ",\"target_rps\":" << options.targetRps
+         << ",\"duration_s\":" << elapsed
+         << ",\"requests\":" << all.count
+         << ",\"ok\":" << ok << ",\"http_errors\":" << httpErrors
+         << ",\"io_errors\":" << ioErrors << ",\"connects\":" << reconnects
+         << ",\"throughput_rps\":" << static_cast<double>(all.count) / elapsed
+         << ",\"p50_ms\":" << ms(all.valueAtPercentile(50))
+         << ",\"p99_ms\":" << ms(all.valueAtPercentile(99))
+         << ",\"p999_ms\":" << ms(all.valueAtPercentile(99.9))
+         << ",\"endpoints\":{";
+    bool first = true;
+    for (int e = 0; e < EndpointCount; e++) {
+        if (perEndpoint[e].count == 0) continue;
+        if (!first) json << ",";
+        first = false;
+        json << "\"" << endpointNames[e] << "\":{\"requests\":" << perEndpoint[e].count
+             << ",\"p50_ms\":" << ms(perEndpoint[e].valueAtPercentile(50))
+             << ",\"p99_ms\":" << ms(perEndpoint[e].valueAtPercentile(99))
+             << ",\"p999_ms\":" << ms(perEndpoint[e].valueAtPercentile(99.9)) << "}";
+    }
+    json << "}}";
+
+    std::cout << "requests " << all.count << " in " << elapsed << "s  ("
+              << static_cast<double>(all.count) / elapsed << " req/s), "
+              << httpErrors << " http errors, " << ioErrors << " io errors\n"
+              << "latency p50 " << ms(all.valueAtPercentile(50)) << " ms  p99 " << ms(all.valueAtPercentile(99))
+              << " ms  p999 " << ms(all.valueAtPercentile(99.9)) << " ms\n";
+    for (int e = 0; e < EndpointCount; e++) {
+        if (perEndpoint[e].count == 0) continue;
+        std::cout << "  " << endpointNames[e] << "  n=" << perEndpoint[e].count
+                  << "  p50 " << ms(perEndpoint[e].valueAtPercentile(50))
+                  << "  p99 " << ms(perEndpoint[e].valueAtPercentile(99))
+                  << "  p999 " << ms(perEndpoint[e].valueAtPercentile(99.9)) << "\n";
+    }
+    std::cout << json.str() << std::endl;
+
+    if (!options.jsonPath.empty()) {
+        std::ofstream out(options.jsonPath);
+        out << json.str() << "\n";
+    }
+    return ioErrors > 0 && all.count == 0 ? 1 : 0;
+}
@@ -0,0 +1,215 @@
+#ifndef ADMISSION_CONTROL_HPP
+#define ADMISSION_CONTROL_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Who gets shed first when the server falls behind. Critical requests
+// (metrics, reload, the page itself) are never shed; interactive ones only
+// when the queue is badly backed up; heavy ones as soon as it stands.
+enum class RequestPriority { Critical, Interactive, Heavy };
+
+// One token bucket per client, refilled lazily on access. Buckets are spread
+// over independently locked shards, each kept in least-recently-used order.
+// A shard that is full drops its least recently seen client to make room, in
+// O(1), so a flood from many addresses cannot grow the table; the dropped
+// client just starts over with a full bucket.
+class ClientRateLimiter {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    ClientRateLimiter(double ratePerSecond, double burst, size_t maxClients = 65536)
+        : rate(ratePerSecond), burst(std::max(1.0, burst)), maxPerShard(std::max<size_t>(1, maxClients / shardCount)) {}
+
+    bool enabled() const { return rate > 0; }
+
+    // False when the client is out of tokens; retryAfterSeconds is then the
+    // wait until the next one.
+    bool tryAcquire(const std::string& client, Clock::time_point now, double* retryAfterSeconds = nullptr) {
+        if (!enabled()) return true;
+        Shard& shard = shards[std::hash<std::string> {}(client) % shardCount];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto found = shard.index.find(client);
+        if (found != shard.index.end()) {
+            shard.order.splice(shard.order.begin(), shard.order, found->second);
+        } else {
+            if (shard.order.size() >= maxPerShard) {
+                shard.index.erase(shard.order.back().first);
+                shard.order.pop_back();
+            }
+            shard.order.emplace_front(client, Bucket {burst, now});
+            shard.index.emplace(client, shard.order.begin());
+        }
+        Bucket& bucket = shard.order.front().second;
+        refill(bucket, now);
+        if (bucket.tokens >= 1.0) {
+            bucket.tokens -= 1.0;
+            return true;
+        }
+        if (retryAfterSeconds) *retryAfterSeconds = (1.0 - bucket.tokens) / rate;
+        return false;
+    }
+
+    size_t trackedClients() const {
+        size_t total = 0;
+        for (const Shard& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            total += shard.order.size();
+        }
+        return total;
+    }
+
+private:
+    struct Bucket {
+        double tokens;
+        Clock::time_point updated;
+    };
+
+    using Entry = std::pair<std::string, Bucket>;
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::list<Entry> order;  // most recently seen first
+        std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    };
+
+    static constexpr size_t shardCount = 16;
+
+    double rate;
+    double burst;
+    size_t maxPerShard;
+    std::array<Shard, shardCount> shards;
+
+    void refill(Bucket& bucket, Clock::time_point now) const {
+        double elapsed = std::chrono::duration<double>(now - bucket.updated).count();
+        bucket.tokens = std::min(burst, bucket.tokens + std::max(0.0, elapsed) * rate);
+        bucket.updated = now;
+    }
+};
+
+// Caps how many requests of each endpoint run at once. A limit of 0 means
+// unlimited; in-flight requests are still counted.
+class ConcurrencyLimiter {
+public:
+    explicit ConcurrencyLimiter(size_t endpointCount)
+        : count(endpointCount),
+          limits(new std::atomic<int>[endpointCount]),
+          running(new std::atomic<int>[endpointCount]) {
+        for (size_t i = 0; i < count; i++) {
+            limits[i] = 0;
+            running[i] = 0;
+        }
+    }
+
+    void setLimit(size_t endpoint, int limit) { limits[endpoint] = std::max(0, limit); }
+    int limit(size_t endpoint) const { return limits[endpoint]; }
+    int active(size_t endpoint) const { return running[endpoint]; }
+
+    bool tryEnter(size_t endpoint) {
+        int cap = limits[endpoint].load(std::memory_order_relaxed);
+        int now = running[endpoint].fetch_add(1, std::memory_order_acq_rel) + 1;
+        if (cap > 0 && now > cap) {
+            running[endpoint].fetch_sub(1, std::memory_order_acq_rel);
+            return false;
+        }
+        return true;
+    }
+
+    void leave(size_t endpoint) { running[endpoint].fetch_sub(1, std::memory_order_acq_rel); }
+
+    // Holds one slot for its lifetime.
+    class Slot {
+    public:
+        Slot() = default;
+        Slot(ConcurrencyLimiter* owner, size_t endpoint) : owner(owner), endpoint(endpoint) {}
+        Slot(Slot&& other) noexcept : owner(other.owner), endpoint(other.endpoint) { other.owner = nullptr; }
+        Slot& operator=(Slot&& other) noexcept {
+            if (this != &other) {
+                release();
+                owner = other.owner;
+                endpoint = other.endpoint;
+                other.owner = nullptr;
+            }
+            return *this;
+        }
+        ~Slot() { release(); }
+
+    private:
+        ConcurrencyLimiter* owner = nullptr;
+        size_t endpoint = 0;
+
+        void release() {
+            if (owner) owner->leave(endpoint);
+            owner = nullptr;
+        }
+    };
+
+private:
+    size_t count;
+    std::unique_ptr<std::atomic<int>[]> limits;
+    std::unique_ptr<std::atomic<int>[]> running;
+};
+
+// Sheds on queue delay, CoDel style: the time requests spent waiting before
+// a worker picked them up. A burst that drains quickly leaves some request
+// in every interval with a short wait, so only a queue that stands for a
+// whole interval (its minimum delay above target) counts as overload. While
+// it stands, a request that itself waited past the threshold is shed: heavy
+// ones above target, interactive ones above severeFactor times target. One
+// that arrives to an empty queue is served, since shedding it saves nothing.
+class QueueDelayShedder {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    QueueDelayShedder(std::chrono::nanoseconds target, std::chrono::nanoseconds interval, uint64_t severeFactor = 8)
+        : targetNanos(static_cast<uint64_t>(target.count())),
+          intervalNanos(static_cast<uint64_t>(interval.count())),
+          severeFactor(severeFactor) {}
+
+    bool enabled() const { return targetNanos > 0; }
+
+    void observe(uint64_t delayNanos, Clock::time_point now) {
+        const uint64_t at = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            now.time_since_epoch()).count());
+        uint64_t started = windowStart.load(std::memory_order_acquire);
+        if (at - started >= intervalNanos && windowStart.compare_exchange_strong(started, at)) {
+            // A whole interval without a single request means the queue was
+            // empty, whatever the window before it saw.
+            uint64_t closed = windowMin.exchange(delayNanos);
+            const bool idle = closed == UINT64_MAX || at - started >= 2 * intervalNanos;
+            standing.store(idle ? 0 : closed, std::memory_order_release);
+            return;
+        }
+        uint64_t seen = windowMin.load(std::memory_order_relaxed);
+        while (delayNanos < seen && !windowMin.compare_exchange_weak(seen, delayNanos)) {
+        }
+    }
+
+    bool shouldShed(RequestPriority priority, uint64_t delayNanos) const {
+        if (!enabled() || priority == RequestPriority::Critical) return false;
+        const uint64_t threshold = priority == RequestPriority::Heavy ? targetNanos : targetNanos * severeFactor;
+        return delayNanos > threshold && standing.load(std::memory_order_acquire) > threshold;
+    }
+
+    uint64_t standingDelayNanos() const { return standing.load(std::memory_order_acquire); }
+
+private:
+    uint64_t targetNanos;
+    uint64_t intervalNanos;
+    uint64_t severeFactor;
+    std::atomic<uint64_t> windowStart {0};
+    std::atomic<uint64_t> windowMin {UINT64_MAX};
+    std::atomic<uint64_t> standing {0};
+};
+
+#endif
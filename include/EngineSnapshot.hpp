@@ -0,0 +1,564 @@
+#ifndef ENGINE_SNAPSHOT_HPP
+#define ENGINE_SNAPSHOT_HPP
+
+#include "MappedFile.hpp"
+#include "WeatherEngine.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// On-disk layout (little-endian, every section 8-byte aligned):
+//
+//   SnapshotHeader | SectionEntry[sectionCount] | section payloads...
+//
+// All cross references are 32-bit indexes or {offset, length} pairs into the
+// string table, so the records can be read straight out of a read-only
+// mapping. The checksum covers every byte after the header.
+namespace snapshot_format {
+constexpr char magic[8] = {'W', 'X', 'S', 'N', 'A', 'P', '\0', '\0'};
+constexpr uint32_t version = 1;
+constexpr uint32_t byteOrderMark = 0x01020304;
+
+enum SectionId : uint32_t {
+    Strings = 1,
+    Cities,
+    Series,
+    Forecasts,
+    EdgeOffsets,
+    Edges,
+    TrieNodes,
+    TrieChildren,
+    TrieNames,
+    Alerts,
+    SectionCount = Alerts
+};
+
+struct StringRef {
+    uint32_t offset;
+    uint32_t length;
+};
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t sectionCount;
+    uint32_t reserved;
+    uint64_t fileBytes;
+    uint64_t checksum;
+};
+
+struct SectionEntry {
+    uint32_t id;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t bytes;
+};
+
+// Series are stored back to back as hourly | weekly | monthly | yearly.
+struct CityRecord {
+    StringRef name;
+    StringRef condition;
+    double lat;
+    double lon;
+    double rain;
+    int32_t temp;
+    int32_t humidity;
+    int32_t wind;
+    int32_t aqi;
+    int32_t windDir;
+    uint32_t seriesOffset;
+    uint32_t seriesLength[4];
+    uint32_t forecastOffset;
+    uint32_t forecastCount;
+};
+
+struct ForecastRecord {
+    StringRef dayName;
+    StringRef condition;
+    int32_t high;
+    int32_t low;
+    int32_t rainProbability;
+    int32_t reserved;
+};
+
+struct EdgeRecord {
+    uint32_t target;
+    int32_t weatherRisk;
+    double distanceKm;
+};
+
+struct TrieNodeRecord {
+    uint32_t firstChild;
+    uint32_t childCount;
+    uint32_t firstName;
+    uint32_t nameCount;
+    uint32_t terminal;
+    uint32_t reserved;
+};
+
+struct TrieChildRecord {
+    uint32_t node;
+    uint32_t ch;
+};
+
+struct AlertRecord {
+    StringRef message;
+    StringRef city;
+    int32_t severity;
+    int32_t reserved;
+};
+
+static_assert(sizeof(SnapshotHeader) % 8 == 0, "header must keep sections aligned");
+static_assert(sizeof(CityRecord) % 8 == 0, "records must stay 8-byte aligned");
+static_assert(sizeof(ForecastRecord) % 8 == 0, "records must stay 8-byte aligned");
+static_assert(sizeof(EdgeRecord) % 8 == 0, "records must stay 8-byte aligned");
+
+// 64-bit FNV-1a folded over whole words; a trailing partial word is zero-padded.
+inline uint64_t checksum(const char* data, size_t size) {
+    uint64_t hash = 14695981039346656037ull;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, 8);
+        hash = (hash ^ word) * 1099511628211ull;
+    }
+    if (i < size) {
+        uint64_t word = 0;
+        std::memcpy(&word, data + i, size - i);
+        hash = (hash ^ word) * 1099511628211ull;
+    }
+    return hash;
+}
+}
+
+// Typed, bounds-checked view over a mapped snapshot. Nothing is copied; the
+// accessors point into the mapping, so the view must not outlive it.
+class SnapshotView {
+public:
+    bool open(const char* data, size_t size, std::string* error = nullptr) {
+        using namespace snapshot_format;
+        base = data;
+        length = size;
+        if (size < sizeof(SnapshotHeader)) return fail(error, "snapshot is truncated");
+
+        const SnapshotHeader& header = *reinterpret_cast<const SnapshotHeader*>(data);
+        if (std::memcmp(header.magic, magic, sizeof(magic)) != 0) return fail(error, "not a weather snapshot");
+        if (header.byteOrder != byteOrderMark) return fail(error, "snapshot was written with another byte order");
+        if (header.version != version) {
+            return fail(error, "unsupported snapshot version " + std::to_string(header.version));
+        }
+        if (header.fileBytes != size) return fail(error, "snapshot size does not match its header");
+        if (header.sectionCount != SectionCount ||
+            sizeof(SnapshotHeader) + header.sectionCount * sizeof(SectionEntry) > size) {
+            return fail(error, "snapshot section table is corrupt");
+        }
+        if (checksum(data + sizeof(SnapshotHeader), size - sizeof(SnapshotHeader)) != header.checksum) {
+            return fail(error, "snapshot checksum mismatch");
+        }
+
+        const SectionEntry* entries = reinterpret_cast<const SectionEntry*>(data + sizeof(SnapshotHeader));
+        for (uint32_t i = 0; i < header.sectionCount; i++) {
+            const SectionEntry& entry = entries[i];
+            if (entry.id < 1 || entry.id > SectionCount || entry.offset % 8 != 0 ||
+                entry.offset > size || entry.bytes > size - entry.offset) {
+                return fail(error, "snapshot section table is corrupt");
+            }
+            sections[entry.id - 1] = entry;
+        }
+        return validate(error);
+    }
+
+    size_t cityCount() const { return count<snapshot_format::CityRecord>(snapshot_format::Cities); }
+    size_t edgeCount() const { return count<snapshot_format::EdgeRecord>(snapshot_format::Edges); }
+    size_t trieNodeCount() const { return count<snapshot_format::TrieNodeRecord>(snapshot_format::TrieNodes); }
+    size_t alertCount() const { return count<snapshot_format::AlertRecord>(snapshot_format::Alerts); }
+
+    const snapshot_format::CityRecord& city(size_t i) const { return records<snapshot_format::CityRecord>(snapshot_format::Cities)[i]; }
+    const snapshot_format::EdgeRecord* edges() const { return records<snapshot_format::EdgeRecord>(snapshot_format::Edges); }
+    const uint32_t* edgeOffsets() const { return records<uint32_t>(snapshot_format::EdgeOffsets); }
+    const snapshot_format::ForecastRecord* forecasts() const { return records<snapshot_format::ForecastRecord>(snapshot_format::Forecasts); }
+    const int32_t* series() const { return records<int32_t>(snapshot_format::Series); }
+    const snapshot_format::TrieNodeRecord& trieNode(size_t i) const { return records<snapshot_format::TrieNodeRecord>(snapshot_format::TrieNodes)[i]; }
+    const snapshot_format::TrieChildRecord* trieChildren() const { return records<snapshot_format::TrieChildRecord>(snapshot_format::TrieChildren); }
+    const snapshot_format::StringRef* trieNames() const { return records<snapshot_format::StringRef>(snapshot_format::TrieNames); }
+    const snapshot_format::AlertRecord& alert(size_t i) const { return records<snapshot_format::AlertRecord>(snapshot_format::Alerts)[i]; }
+
+    std::string_view text(snapshot_format::StringRef ref) const {
+        return std::string_view(base + sections[snapshot_format::Strings - 1].offset + ref.offset, ref.length);
+    }
+
+private:
+    const char* base = nullptr;
+    size_t length = 0;
+    snapshot_format::SectionEntry sections[snapshot_format::SectionCount] {};
+
+    template <typename T>
+    const T* records(uint32_t id) const {
+        return reinterpret_cast<const T*>(base + sections[id - 1].offset);
+    }
+
+    template <typename T>
+    size_t count(uint32_t id) const {
+        return static_cast<size_t>(sections[id - 1].bytes / sizeof(T));
+    }
+
+    bool validRef(snapshot_format::StringRef ref) const {
+        uint64_t bytes = sections[snapshot_format::Strings - 1].bytes;
+        return ref.offset <= bytes && ref.length <= bytes - ref.offset;
+    }
+
+    bool validate(std::string* error) {
+        using namespace snapshot_format;
+        const size_t cities = cityCount();
+        const size_t seriesCount = count<int32_t>(Series);
+        const size_t forecastCount = count<ForecastRecord>(Forecasts);
+        for (size_t i = 0; i < cities; i++) {
+            const CityRecord& record = city(i);
+            uint64_t seriesEnd = record.seriesOffset;
+            for (uint32_t len : record.seriesLength) seriesEnd += len;
+            if (!validRef(record.name) || !validRef(record.condition) || seriesEnd > seriesCount ||
+                static_cast<uint64_t>(record.forecastOffset) + record.forecastCount > forecastCount) {
+                return fail(error, "snapshot city record " + std::to_string(i) + " is corrupt");
+            }
+        }
+        for (size_t i = 0; i < forecastCount; i++) {
+            if (!validRef(forecasts()[i].dayName) || !validRef(forecasts()[i].condition)) {
+                return fail(error, "snapshot forecast table is corrupt");
+            }
+        }
+
+        if (count<uint32_t>(EdgeOffsets) != cities + 1) return fail(error, "snapshot edge index is corrupt");
+        for (size_t i = 0; i < cities; i++) {
+            if (edgeOffsets()[i] > edgeOffsets()[i + 1]) return fail(error, "snapshot edge index is corrupt");
+        }
+        if (edgeOffsets()[cities] != edgeCount()) return fail(error, "snapshot edge index is corrupt");
+        for (size_t i = 0; i < edgeCount(); i++) {
+            if (edges()[i].target >= cities) return fail(error, "snapshot edge target is corrupt");
+        }
+
+        const size_t nodes = trieNodeCount();
+        const size_t children = count<TrieChildRecord>(TrieChildren);
+        const size_t names = count<StringRef>(TrieNames);
+        if (nodes == 0) return fail(error, "snapshot trie is missing its root");
+        // Every node but the root must be the child of exactly one parent,
+        // and no parent may have two children under the same character.
+        std::vector<bool> referenced(nodes, false);
+        bool seenChar[256] = {};
+        for (size_t i = 0; i < nodes; i++) {
+            const TrieNodeRecord& node = trieNode(i);
+            if (static_cast<uint64_t>(node.firstChild) + node.childCount > children ||
+                static_cast<uint64_t>(node.firstName) + node.nameCount > names) {
+                return fail(error, "snapshot trie is corrupt");
+            }
+            bool valid = true;
+            uint32_t c = 0;
+            for (; c < node.childCount && valid; c++) {
+                // Nodes are numbered breadth-first, so children always follow their parent.
+                const TrieChildRecord& child = trieChildren()[node.firstChild + c];
+                const unsigned char ch = static_cast<unsigned char>(child.ch);
+                valid = child.ch < 256 && child.node > i && child.node < nodes && !referenced[child.node] && !seenChar[ch];
+                if (valid) referenced[child.node] = seenChar[ch] = true;
+            }
+            while (c-- > 0) seenChar[static_cast<unsigned char>(trieChildren()[node.firstChild + c].ch)] = false;
+            if (!valid) return fail(error, "snapshot trie is corrupt");
+        }
+        for (size_t i = 1; i < nodes; i++) {
+            if (!referenced[i]) return fail(error, "snapshot trie is corrupt");
+        }
+        for (size_t i = 0; i < names; i++) {
+            if (!validRef(trieNames()[i])) return fail(error, "snapshot trie is corrupt");
+        }
+        for (size_t i = 0; i < alertCount(); i++) {
+            if (!validRef(alert(i).message) || !validRef(alert(i).city)) return fail(error, "snapshot alerts are corrupt");
+        }
+        return true;
+    }
+
+    bool fail(std::string* error, const std::string& message) {
+        if (error) *error = message;
+        return false;
+    }
+};
+
+class EngineSnapshot {
+public:
+    static bool save(const WeatherEngine& engine, const std::string& path, std::string* error = nullptr) {
+        using namespace snapshot_format;
+        Writer writer;
+
+        std::vector<const std::string*> keys;
+        keys.reserve(engine.cityDatabase.size());
+        for (const auto& pair : engine.cityDatabase) keys.push_back(&pair.first);
+        std::sort(keys.begin(), keys.end(), [](const std::string* a, const std::string* b) { return *a < *b; });
+        std::unordered_map<std::string, uint32_t> cityIndex;
+        cityIndex.reserve(keys.size());
+        for (size_t i = 0; i < keys.size(); i++) cityIndex[*keys[i]] = static_cast<uint32_t>(i);
+
+        std::vector<CityRecord> cities;
+        std::vector<int32_t> series;
+        std::vector<ForecastRecord> forecasts;
+        cities.reserve(keys.size());
+        for (const std::string* key : keys) {
+            const City& city = engine.cityDatabase.at(*key);
+            CityRecord record {};
+            record.name = writer.intern(city.name);
+            record.condition = writer.intern(city.condition);
+            record.lat = city.lat;
+            record.lon = city.lon;
+            record.rain = city.rain;
+            record.temp = city.temp;
+            record.humidity = city.humidity;
+            record.wind = city.wind;
+            record.aqi = city.aqi;
+            record.windDir = city.windDir;
+            record.seriesOffset = static_cast<uint32_t>(series.size());
+            const std::vector<int>* seriesList[] = {&city.hourlyData, &city.weeklyData, &city.monthlyData, &city.yearlyData};
+            for (size_t s = 0; s < 4; s++) {
+                record.seriesLength[s] = static_cast<uint32_t>(seriesList[s]->size());
+                series.insert(series.end(), seriesList[s]->begin(), seriesList[s]->end());
+            }
+            record.forecastOffset = static_cast<uint32_t>(forecasts.size());
+            record.forecastCount = static_cast<uint32_t>(city.tenDayForecast.size());
+            for (const DailyForecast& day : city.tenDayForecast) {
+                forecasts.push_back({writer.intern(day.dayName), writer.intern(day.condition),
+                                     day.high, day.low, day.rainProbability, 0});
+            }
+            cities.push_back(record);
+        }
+
+        std::vector<uint32_t> edgeOffsets;
+        std::vector<EdgeRecord> edges;
+        edgeOffsets.reserve(keys.size() + 1);
+        for (const std::string* key : keys) {
+            edgeOffsets.push_back(static_cast<uint32_t>(edges.size()));
+            auto it = engine.cityGraph.find(*key);
+            if (it == engine.cityGraph.end()) continue;
+            for (const RouteEdge& edge : it->second) {
+                auto target = cityIndex.find(WeatherEngine::normalize(edge.city));
+                if (target == cityIndex.end()) continue;
+                edges.push_back({target->second, edge.weatherRisk, edge.distanceKm});
+            }
+        }
+        edgeOffsets.push_back(static_cast<uint32_t>(edges.size()));
+
+        std::vector<TrieNodeRecord> trieNodes;
+        std::vector<TrieChildRecord> trieChildren;
+        std::vector<StringRef> trieNames;
+        std::vector<const WeatherEngine::TrieNode*> order = {engine.trieRoot.get()};
+        for (size_t i = 0; i < order.size(); i++) {
+            const WeatherEngine::TrieNode* node = order[i];
+            TrieNodeRecord record {};
+            record.terminal = node->terminal ? 1 : 0;
+            record.firstName = static_cast<uint32_t>(trieNames.size());
+            record.nameCount = static_cast<uint32_t>(node->names.size());
+            for (const std::string& name : node->names) trieNames.push_back(writer.intern(name));
+
+            std::map<unsigned char, const WeatherEngine::TrieNode*> sorted;
+            for (const auto& child : node->children) sorted[static_cast<unsigned char>(child.first)] = child.second.get();
+            record.firstChild = static_cast<uint32_t>(trieChildren.size());
+            record.childCount = static_cast<uint32_t>(sorted.size());
+            for (const auto& child : sorted) {
+                trieChildren.push_back({static_cast<uint32_t>(order.size()), child.first});
+                order.push_back(child.second);
+            }
+            trieNodes.push_back(record);
+        }
+
+        std::vector<AlertRecord> alerts;
+        for (const Alert& alert : engine.getTopAlerts(static_cast<int>(engine.alertSystem.size()))) {
+            alerts.push_back({writer.intern(alert.message), writer.intern(alert.city), alert.severity, 0});
+        }
+
+        writer.add(Strings, writer.strings.data(), writer.strings.size());
+        writer.addVector(Cities, cities);
+        writer.addVector(Series, series);
+        writer.addVector(Forecasts, forecasts);
+        writer.addVector(EdgeOffsets, edgeOffsets);
+        writer.addVector(Edges, edges);
+        writer.addVector(TrieNodes, trieNodes);
+        writer.addVector(TrieChildren, trieChildren);
+        writer.addVector(TrieNames, trieNames);
+        writer.addVector(Alerts, alerts);
+        return writer.write(path, error);
+    }
+
+    // Maps the snapshot, validates it and restores the engine from the mapped
+    // records. Only the containers the engine owns are built; nothing is parsed
+    // and no derived series is regenerated. The engine must have no cities:
+    // a snapshot replaces the trie and edge ids wholesale, so it cannot merge.
+    static bool load(WeatherEngine& engine, const std::string& path, std::string* error = nullptr) {
+        if (!engine.cityDatabase.empty()) {
+            if (error) *error = "snapshot can only be loaded into an empty engine";
+            return false;
+        }
+        MappedFile file;
+        if (!file.open(path, error)) return false;
+        SnapshotView view;
+        if (!view.open(file.data(), file.size(), error)) return false;
+        restore(engine, view);
+        return true;
+    }
+
+private:
+    static void restore(WeatherEngine& engine, const SnapshotView& view) {
+        using namespace snapshot_format;
+        const size_t cityCount = view.cityCount();
+        std::vector<std::string> keys(cityCount);
+        std::vector<std::string> names(cityCount);
+        std::vector<size_t> ids(cityCount);
+        engine.cityDatabase.reserve(cityCount);
+        engine.seriesStore.reserve(cityCount);
+        for (size_t i = 0; i < cityCount; i++) {
+            const CityRecord& record = view.city(i);
+            City city;
+            city.name = std::string(view.text(record.name));
+            city.condition = std::string(view.text(record.condition));
+            city.lat = record.lat;
+            city.lon = record.lon;
+            city.rain = record.rain;
+            city.temp = record.temp;
+            city.humidity = record.humidity;
+            city.wind = record.wind;
+            city.aqi = record.aqi;
+            city.windDir = record.windDir;
+            const int32_t* values = view.series() + record.seriesOffset;
+            std::vector<int>* seriesList[] = {&city.hourlyData, &city.weeklyData, &city.monthlyData, &city.yearlyData};
+            for (size_t s = 0; s < 4; s++) {
+                seriesList[s]->assign(values, values + record.seriesLength[s]);
+                values += record.seriesLength[s];
+            }
+            city.tenDayForecast.reserve(record.forecastCount);
+            for (uint32_t f = 0; f < record.forecastCount; f++) {
+                const ForecastRecord& day = view.forecasts()[record.forecastOffset + f];
+                city.tenDayForecast.push_back({std::string(view.text(day.dayName)), day.high, day.low,
+                                               day.rainProbability, std::string(view.text(day.condition))});
+            }
+            names[i] = city.name;
+            keys[i] = WeatherEngine::normalize(city.name);
+            engine.storeCity(keys[i], std::move(city));
+            ids[i] = engine.cityDatabase.at(keys[i]).id;
+        }
+        engine.reindexCities();
+
+        engine.cityGraph.reserve(cityCount);
+        for (size_t i = 0; i < cityCount; i++) {
+            uint32_t first = view.edgeOffsets()[i];
+            uint32_t last = view.edgeOffsets()[i + 1];
+            if (first == last) continue;
+            std::vector<RouteEdge>& adjacency = engine.edgesOf(keys[i], ids[i]);
+            adjacency.reserve(last - first);
+            for (uint32_t e = first; e < last; e++) {
+                const EdgeRecord& edge = view.edges()[e];
+                adjacency.push_back({names[edge.target], edge.distanceKm, edge.weatherRisk, ids[edge.target]});
+            }
+        }
+
+        std::vector<WeatherEngine::TrieNode*> nodes(view.trieNodeCount(), nullptr);
+        engine.trieRoot = std::make_unique<WeatherEngine::TrieNode>();
+        nodes[0] = engine.trieRoot.get();
+        for (size_t i = 0; i < nodes.size(); i++) {
+            const TrieNodeRecord& record = view.trieNode(i);
+            WeatherEngine::TrieNode* node = nodes[i];
+            node->terminal = record.terminal != 0;
+            node->names.reserve(record.nameCount);
+            for (uint32_t n = 0; n < record.nameCount; n++) {
+                node->names.emplace_back(view.text(view.trieNames()[record.firstName + n]));
+            }
+            node->children.reserve(record.childCount);
+            for (uint32_t c = 0; c < record.childCount; c++) {
+                const TrieChildRecord& child = view.trieChildren()[record.firstChild + c];
+                auto& slot = node->children[static_cast<char>(child.ch)];
+                slot = std::make_unique<WeatherEngine::TrieNode>();
+                nodes[child.node] = slot.get();
+            }
+        }
+
+        for (size_t i = 0; i < view.alertCount(); i++) {
+            const AlertRecord& alert = view.alert(i);
+            engine.addAlert(alert.severity, std::string(view.text(alert.message)), std::string(view.text(alert.city)));
+        }
+    }
+
+    struct Writer {
+        std::string strings;
+        std::unordered_map<std::string, snapshot_format::StringRef> interned;
+        std::vector<std::pair<uint32_t, std::string>> sections;
+
+        snapshot_format::StringRef intern(const std::string& value) {
+            auto it = interned.find(value);
+            if (it != interned.end()) return it->second;
+            snapshot_format::StringRef ref {static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(value.size())};
+            strings += value;
+            interned.emplace(value, ref);
+            return ref;
+        }
+
+        void add(uint32_t id, const void* data, size_t bytes) {
+            sections.emplace_back(id, std::string(static_cast<const char*>(data), bytes));
+        }
+
+        template <typename T>
+        void addVector(uint32_t id, const std::vector<T>& values) {
+            add(id, values.data(), values.size() * sizeof(T));
+        }
+
+        bool write(const std::string& path, std::string* error) {
+            using namespace snapshot_format;
+            std::string file(sizeof(SnapshotHeader) + sections.size() * sizeof(SectionEntry), '\0');
+            std::vector<SectionEntry> entries;
+            for (const auto& section : sections) {
+                file.resize((file.size() + 7) & ~size_t{7}, '\0');
+                entries.push_back({section.first, 0, file.size(), section.second.size()});
+                file += section.second;
+            }
+            file.resize((file.size() + 7) & ~size_t{7}, '\0');
+            std::memcpy(&file[sizeof(SnapshotHeader)], entries.data(), entries.size() * sizeof(SectionEntry));
+
+            SnapshotHeader header {};
+            std::memcpy(header.magic, magic, sizeof(magic));
+            header.version = version;
+            header.byteOrder = byteOrderMark;
+            header.sectionCount = static_cast<uint32_t>(entries.size());
+            header.fileBytes = file.size();
+            header.checksum = checksum(file.data() + sizeof(SnapshotHeader), file.size() - sizeof(SnapshotHeader));
+            std::memcpy(&file[0], &header, sizeof(header));
+
+            // Write to a side file and rename so a crash never leaves a torn snapshot.
+            const std::string tempPath = path + ".tmp";
+            {
+                std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+                if (!out.is_open()) {
+                    if (error) *error = "Could not write " + tempPath;
+                    return false;
+                }
+                out.write(file.data(), static_cast<std::streamsize>(file.size()));
+                if (!out.good()) {
+                    if (error) *error = "Could not write " + tempPath;
+                    return false;
+                }
+            }
+            // rename() replaces the old snapshot atomically on POSIX; Windows
+            // needs MoveFileEx to do the same.
+#ifdef _WIN32
+            if (!MoveFileExA(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+#else
+            if (std::rename(tempPath.c_str(), path.c_str()) != 0) {
+#endif
+                if (error) *error = "Could not rename " + tempPath + " to " + path;
+                return false;
+            }
+            return true;
+        }
+    };
+};
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef LRU_CACHE_HPP
+#define LRU_CACHE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Bounded, thread-safe least-recently-used cache of immutable values. Keys are
+// spread over independently locked shards so concurrent readers rarely meet on
+// the same mutex; each shard evicts its own oldest entry once it is full.
+// Values are handed out as shared_ptr, so an evicted value stays alive for as
+// long as a caller still holds it. A capacity of 0 disables caching.
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class LruCache {
+public:
+    explicit LruCache(size_t capacity, size_t shardCount = 16)
+        : totalCapacity(capacity),
+          shards(std::max<size_t>(1, std::min(shardCount, capacity))) {
+        for (size_t i = 0; i < shards.size(); i++) {
+            shards[i].capacity = capacity / shards.size() + (i < capacity % shards.size() ? 1 : 0);
+        }
+    }
+
+    LruCache(const LruCache&) = delete;
+    LruCache& operator=(const LruCache&) = delete;
+
+    std::shared_ptr<const Value> find(const Key& key) {
+        Shard& shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(key);
+        if (it == shard.index.end()) return nullptr;
+        shard.order.splice(shard.order.begin(), shard.order, it->second);
+        return it->second->second;
+    }
+
+    // Returns the cached value, or builds it with make() outside the lock and
+    // inserts it. If two threads miss at once both build, and the first insert
+    // wins. hit reports whether the value came from the cache.
+    template <typename Make>
+    std::shared_ptr<const Value> findOrCreate(const Key& key, Make make, bool* hit = nullptr) {
+        if (std::shared_ptr<const Value> cached = find(key)) {
+            if (hit) *hit = true;
+            return cached;
+        }
+        if (hit) *hit = false;
+        std::shared_ptr<const Value> built = std::make_shared<const Value>(make());
+        if (totalCapacity == 0) return built;
+
+        Shard& shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(key);
+        if (it != shard.index.end()) {
+            shard.order.splice(shard.order.begin(), shard.order, it->second);
+            return it->second->second;
+        }
+        shard.order.emplace_front(key, built);
+        shard.index.emplace(key, shard.order.begin());
+        if (shard.order.size() > shard.capacity) {
+            shard.index.erase(shard.order.back().first);
+            shard.order.pop_back();
+        }
+        return built;
+    }
+
+    void erase(const Key& key) {
+        Shard& shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(key);
+        if (it == shard.index.end()) return;
+        shard.order.erase(it->second);
+        shard.index.erase(it);
+    }
+
+    size_t size() const {
+        size_t total = 0;
+        for (const Shard& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            total += shard.order.size();
+        }
+        return total;
+    }
+
+    size_t capacity() const { return totalCapacity; }
+
+private:
+    using Entry = std::pair<Key, std::shared_ptr<const Value>>;
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::list<Entry> order;
+        std::unordered_map<Key, typename std::list<Entry>::iterator, Hash> index;
+        size_t capacity = 0;
+    };
+
+    size_t totalCapacity;
+    std::vector<Shard> shards;
+
+    Shard& shardFor(const Key& key) {
+        return shards[Hash {}(key) % shards.size()];
+    }
+};
+
+#endif
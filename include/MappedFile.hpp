@@ -0,0 +1,132 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read-only memory mapping of a whole file. An empty file maps to an empty
+// range rather than an error.
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) noexcept {
+        *this = std::move(other);
+    }
+
+    MappedFile& operator=(MappedFile&& other) noexcept {
+        if (this != &other) {
+            close();
+            bytes = other.bytes;
+            length = other.length;
+            isOpen = other.isOpen;
+#ifdef _WIN32
+            fileHandle = other.fileHandle;
+            mappingHandle = other.mappingHandle;
+            other.fileHandle = INVALID_HANDLE_VALUE;
+            other.mappingHandle = nullptr;
+#endif
+            other.bytes = nullptr;
+            other.length = 0;
+            other.isOpen = false;
+        }
+        return *this;
+    }
+
+    ~MappedFile() {
+        close();
+    }
+
+    bool open(const std::string& path, std::string* error = nullptr) {
+        close();
+#ifdef _WIN32
+        fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                 FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (fileHandle == INVALID_HANDLE_VALUE) return fail(error, "Could not open " + path);
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(fileHandle, &size)) return fail(error, "Could not stat " + path);
+        length = static_cast<size_t>(size.QuadPart);
+        if (length > 0) {
+            mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (!mappingHandle) return fail(error, "Could not map " + path);
+            bytes = static_cast<const char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+            if (!bytes) return fail(error, "Could not map " + path);
+        }
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return fail(error, "Could not open " + path);
+        struct stat info {};
+        if (fstat(fd, &info) != 0) {
+            ::close(fd);
+            return fail(error, "Could not stat " + path);
+        }
+        length = static_cast<size_t>(info.st_size);
+        if (length > 0) {
+            void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED) {
+                ::close(fd);
+                return fail(error, "Could not map " + path);
+            }
+            bytes = static_cast<const char*>(mapped);
+            madvise(mapped, length, MADV_SEQUENTIAL);
+        }
+        ::close(fd);
+#endif
+        isOpen = true;
+        return true;
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (bytes) UnmapViewOfFile(bytes);
+        if (mappingHandle) CloseHandle(mappingHandle);
+        if (fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+        mappingHandle = nullptr;
+        fileHandle = INVALID_HANDLE_VALUE;
+#else
+        if (bytes) munmap(const_cast<char*>(bytes), length);
+#endif
+        bytes = nullptr;
+        length = 0;
+        isOpen = false;
+    }
+
+    const char* data() const { return bytes; }
+    size_t size() const { return length; }
+    bool good() const { return isOpen; }
+
+private:
+    const char* bytes = nullptr;
+    size_t length = 0;
+    bool isOpen = false;
+#ifdef _WIN32
+    HANDLE fileHandle = INVALID_HANDLE_VALUE;
+    HANDLE mappingHandle = nullptr;
+#endif
+
+    bool fail(std::string* error, const std::string& message) {
+        if (error) *error = message;
+        close();
+        return false;
+    }
+};
+
+#endif
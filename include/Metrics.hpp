@@ -0,0 +1,316 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// HDR-style log-linear histogram: every power of two is split into 8 linear
+// sub-buckets, so any recorded value is off by at most ~12%. Values are
+// nanoseconds. Each instance has a single writer (its owning thread); readers
+// only ever load, so recording never takes a lock or a contended RMW.
+class LatencyHistogram {
+public:
+    static constexpr int subBucketBits = 3;
+    static constexpr int subBuckets = 1 << subBucketBits;
+    static constexpr int maxExponent = 40;
+    static constexpr int bucketCount = (maxExponent - subBucketBits + 1) * subBuckets;
+
+    static int bucketIndex(uint64_t value) {
+        if (value < static_cast<uint64_t>(subBuckets)) return static_cast<int>(value);
+        int exponent = 63;
+        while (!(value >> exponent)) exponent--;
+        if (exponent >= maxExponent) {
+            exponent = maxExponent - 1;
+            value = (uint64_t{1} << maxExponent) - 1;
+        }
+        int shift = exponent - subBucketBits;
+        return (exponent - subBucketBits + 1) * subBuckets + static_cast<int>((value >> shift) & (subBuckets - 1));
+    }
+
+    static uint64_t bucketUpperBound(int index) {
+        if (index < subBuckets) return static_cast<uint64_t>(index);
+        int exponent = index / subBuckets + subBucketBits - 1;
+        uint64_t mantissa = static_cast<uint64_t>(subBuckets + index % subBuckets);
+        return ((mantissa + 1) << (exponent - subBucketBits)) - 1;
+    }
+
+    void record(uint64_t value) {
+        bump(counts[bucketIndex(value)], 1);
+        bump(total, 1);
+        bump(sum, value);
+    }
+
+    void addTo(std::vector<uint64_t>& out, uint64_t& outCount, uint64_t& outSum) const {
+        out.resize(bucketCount, 0);
+        for (int i = 0; i < bucketCount; i++) out[i] += counts[i].load(std::memory_order_relaxed);
+        outCount += total.load(std::memory_order_relaxed);
+        outSum += sum.load(std::memory_order_relaxed);
+    }
+
+    static void bump(std::atomic<uint64_t>& cell, uint64_t n) {
+        cell.store(cell.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, bucketCount> counts {};
+    std::atomic<uint64_t> total {0};
+    std::atomic<uint64_t> sum {0};
+};
+
+struct HistogramSnapshot {
+    std::vector<uint64_t> counts;
+    uint64_t count = 0;
+    uint64_t sum = 0;
+
+    uint64_t valueAtPercentile(double percentile) const {
+        if (count == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>(percentile / 100.0 * static_cast<double>(count) + 0.5);
+        if (rank < 1) rank = 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts.size(); i++) {
+            seen += counts[i];
+            if (seen >= rank) return LatencyHistogram::bucketUpperBound(static_cast<int>(i));
+        }
+        return LatencyHistogram::bucketUpperBound(static_cast<int>(counts.size()) - 1);
+    }
+
+    uint64_t countAtOrBelow(uint64_t value) const {
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts.size(); i++) {
+            if (LatencyHistogram::bucketUpperBound(static_cast<int>(i)) > value) break;
+            seen += counts[i];
+        }
+        return seen;
+    }
+};
+
+enum class RequestStage { Parse, Route, Serialize, Send, Total, Count };
+enum class EngineCounter { DijkstraNodesExpanded, TrieNodesVisited, CacheHits, CacheMisses, ResponseCacheHits,
+                           CoalescedRequests, CoalesceFallbacks, RateLimited, ShedQueueDelay, ShedConcurrency,
+                           Count };
+
+// One shard per thread. Shards are never freed so that counts recorded by a
+// thread that has exited still show up in the aggregate.
+class MetricsShard {
+public:
+    explicit MetricsShard(size_t routeCount)
+        : histograms(routeCount * static_cast<size_t>(RequestStage::Count)),
+          requests(routeCount),
+          errors(routeCount) {}
+
+    void recordStage(size_t route, RequestStage stage, uint64_t nanos) {
+        histograms[route * static_cast<size_t>(RequestStage::Count) + static_cast<size_t>(stage)].record(nanos);
+    }
+
+    void countRequest(size_t route, int statusCode) {
+        LatencyHistogram::bump(requests[route], 1);
+        if (statusCode >= 400) LatencyHistogram::bump(errors[route], 1);
+    }
+
+    void countEngine(EngineCounter counter, uint64_t n) {
+        LatencyHistogram::bump(engine[static_cast<size_t>(counter)], n);
+    }
+
+private:
+    friend class Metrics;
+    std::vector<LatencyHistogram> histograms;
+    std::vector<std::atomic<uint64_t>> requests;
+    std::vector<std::atomic<uint64_t>> errors;
+    std::array<std::atomic<uint64_t>, static_cast<size_t>(EngineCounter::Count)> engine {};
+};
+
+class Metrics {
+public:
+    // Route names must be registered before the first request is recorded;
+    // index routeNames.size() - 1 is conventionally the catch-all route.
+    static void setRouteNames(std::vector<std::string> names) {
+        Metrics& self = instance();
+        std::lock_guard<std::mutex> lock(self.registryMutex);
+        if (self.shards.empty()) self.routeNames = std::move(names);
+    }
+
+    static MetricsShard& local() {
+        thread_local MetricsShard* shard = instance().registerShard();
+        return *shard;
+    }
+
+    static void count(EngineCounter counter, uint64_t n = 1) {
+        if (n > 0) local().countEngine(counter, n);
+    }
+
+    static HistogramSnapshot histogram(size_t route, RequestStage stage) {
+        Metrics& self = instance();
+        HistogramSnapshot snapshot;
+        std::lock_guard<std::mutex> lock(self.registryMutex);
+        for (const auto& shard : self.shards) {
+            shard->histograms[route * static_cast<size_t>(RequestStage::Count) + static_cast<size_t>(stage)]
+                .addTo(snapshot.counts, snapshot.count, snapshot.sum);
+        }
+        return snapshot;
+    }
+
+    static uint64_t engineTotal(EngineCounter counter) {
+        Metrics& self = instance();
+        uint64_t total = 0;
+        std::lock_guard<std::mutex> lock(self.registryMutex);
+        for (const auto& shard : self.shards) {
+            total += shard->engine[static_cast<size_t>(counter)].load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    static std::string prometheusText() {
+        Metrics& self = instance();
+        const size_t routeCount = self.routeNames.size();
+        const char* stageNames[] = {"parse", "route", "serialize", "send", "total"};
+
+        std::vector<uint64_t> requests(routeCount, 0);
+        std::vector<uint64_t> errors(routeCount, 0);
+        {
+            std::lock_guard<std::mutex> lock(self.registryMutex);
+            for (const auto& shard : self.shards) {
+                for (size_t r = 0; r < routeCount; r++) {
+                    requests[r] += shard->requests[r].load(std::memory_order_relaxed);
+                    errors[r] += shard->errors[r].load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        std::ostringstream out;
+        out << "# HELP weather_http_requests_total Requests handled, by API path.\n"
+            << "# TYPE weather_http_requests_total counter\n";
+        for (size_t r = 0; r < routeCount; r++) {
+            out << "weather_http_requests_total{path=\"" << self.routeNames[r] << "\"} " << requests[r] << "\n";
+        }
+        out << "# HELP weather_http_request_errors_total Requests answered with a 4xx/5xx status, by API path.\n"
+            << "# TYPE weather_http_request_errors_total counter\n";
+        for (size_t r = 0; r < routeCount; r++) {
+            out << "weather_http_request_errors_total{path=\"" << self.routeNames[r] << "\"} " << errors[r] << "\n";
+        }
+
+        out << "# HELP weather_http_request_duration_seconds Time spent in each request stage.\n"
+            << "# TYPE weather_http_request_duration_seconds histogram\n";
+        std::ostringstream quantiles;
+        for (size_t r = 0; r < routeCount; r++) {
+            for (size_t s = 0; s < static_cast<size_t>(RequestStage::Count); s++) {
+                HistogramSnapshot snapshot = histogram(r, static_cast<RequestStage>(s));
+                if (snapshot.count == 0) continue;
+                const std::string labels = "path=\"" + self.routeNames[r] + "\",stage=\"" + stageNames[s] + "\"";
+                // Exported boundaries are the powers of two from ~1us to ~68s.
+                for (int exponent = 10; exponent <= 36; exponent++) {
+                    uint64_t bound = (uint64_t{1} << exponent) - 1;
+                    out << "weather_http_request_duration_seconds_bucket{" << labels
+                        << ",le=\"" << secondsText(bound + 1) << "\"} " << snapshot.countAtOrBelow(bound) << "\n";
+                }
+                out << "weather_http_request_duration_seconds_bucket{" << labels << ",le=\"+Inf\"} " << snapshot.count << "\n"
+                    << "weather_http_request_duration_seconds_sum{" << labels << "} " << secondsText(snapshot.sum) << "\n"
+                    << "weather_http_request_duration_seconds_count{" << labels << "} " << snapshot.count << "\n";
+
+                if (static_cast<RequestStage>(s) == RequestStage::Total) {
+                    for (double q : {50.0, 90.0, 99.0, 99.9}) {
+                        quantiles << "weather_http_request_latency_seconds{path=\"" << self.routeNames[r]
+                                  << "\",quantile=\"" << q / 100.0 << "\"} "
+                                  << secondsText(snapshot.valueAtPercentile(q)) << "\n";
+                    }
+                    quantiles << "weather_http_request_latency_seconds_sum{path=\"" << self.routeNames[r] << "\"} "
+                              << secondsText(snapshot.sum) << "\n"
+                              << "weather_http_request_latency_seconds_count{path=\"" << self.routeNames[r] << "\"} "
+                              << snapshot.count << "\n";
+                }
+            }
+        }
+        out << "# HELP weather_http_request_latency_seconds End-to-end latency quantiles from the HDR histograms.\n"
+            << "# TYPE weather_http_request_latency_seconds summary\n"
+            << quantiles.str();
+
+        const char* counterNames[] = {"weather_dijkstra_nodes_expanded_total",
+                                      "weather_trie_nodes_visited_total",
+                                      "weather_cache_hits_total",
+                                      "weather_cache_misses_total",
+                                      "weather_response_cache_hits_total",
+                                      "weather_coalesced_requests_total",
+                                      "weather_coalesce_fallbacks_total",
+                                      "weather_rate_limited_total",
+                                      "weather_shed_queue_delay_total",
+                                      "weather_shed_concurrency_total"};
+        const char* counterHelp[] = {"Nodes settled by Dijkstra searches.",
+                                     "Trie nodes walked by autocomplete lookups.",
+                                     "Lookups answered from an in-memory cache.",
+                                     "Cache lookups that had to build the value.",
+                                     "API responses replayed from a reactor's own response cache.",
+                                     "Requests answered by joining an identical in-flight request.",
+                                     "Requests that computed alone because the waiter bound or timeout was hit.",
+                                     "Requests refused with 429 because the client ran out of tokens.",
+                                     "Requests refused with 503 because the queue delay stood above target.",
+                                     "Requests refused with 503 because their endpoint was at its concurrency limit."};
+        for (size_t c = 0; c < static_cast<size_t>(EngineCounter::Count); c++) {
+            out << "# HELP " << counterNames[c] << " " << counterHelp[c] << "\n"
+                << "# TYPE " << counterNames[c] << " counter\n"
+                << counterNames[c] << " " << engineTotal(static_cast<EngineCounter>(c)) << "\n";
+        }
+        return out.str();
+    }
+
+private:
+    std::mutex registryMutex;
+    std::vector<std::string> routeNames {"other"};
+    std::vector<std::unique_ptr<MetricsShard>> shards;
+
+    static Metrics& instance() {
+        static Metrics metrics;
+        return metrics;
+    }
+
+    MetricsShard* registerShard() {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        shards.push_back(std::make_unique<MetricsShard>(routeNames.size()));
+        return shards.back().get();
+    }
+
+    static std::string secondsText(uint64_t nanos) {
+        std::ostringstream out;
+        out << nanos / 1000000000 << "." << std::setw(9) << std::setfill('0') << nanos % 1000000000;
+        return out.str();
+    }
+};
+
+// Accumulates per-stage durations for one request. mark() closes the stage
+// that has been running since the previous mark.
+class RequestTrace {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    RequestTrace() : started(Clock::now()), lastMark(started) {}
+
+    void mark(RequestStage stage) {
+        Clock::time_point now = Clock::now();
+        stageNanos[static_cast<size_t>(stage)] +=
+            static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - lastMark).count());
+        lastMark = now;
+    }
+
+    void finish(size_t route, int statusCode) {
+        stageNanos[static_cast<size_t>(RequestStage::Total)] =
+            static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - started).count());
+        MetricsShard& shard = Metrics::local();
+        for (size_t s = 0; s < static_cast<size_t>(RequestStage::Count); s++) {
+            shard.recordStage(route, static_cast<RequestStage>(s), stageNanos[s]);
+        }
+        shard.countRequest(route, statusCode);
+    }
+
+private:
+    Clock::time_point started;
+    Clock::time_point lastMark;
+    std::array<uint64_t, static_cast<size_t>(RequestStage::Count)> stageNanos {};
+};
+
+#endif
@@ -4,8 +4,10 @@
 #include <cctype>
 #include <fstream>
 #include <iomanip>
+#include <memory_resource>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 
 #ifdef _WIN32
@@ -19,6 +21,7 @@
 #include <ws2tcpip.h>
 #pragma comment(lib, "Ws2_32.lib")
 #else
+#include <arpa/inet.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
 #include <unistd.h>
@@ -28,6 +31,10 @@
 #define closesocket close
 #endif
 
+// Decoded query parameters. They live in whatever resource parseQuery was
+// given, usually the request's arena.
+using QueryParams = std::pmr::unordered_map<std::pmr::string, std::pmr::string>;
+
 class SimpleServer {
 public:
     static bool initNetwork() {
@@ -53,53 +60,103 @@ public:
         return buffer.str();
     }
 
+    // Appends the status line, headers and body to out, which a caller can
+    // keep and reuse across responses.
+    static void appendResponse(std::string& out,
+                               std::string_view body,
+                               std::string_view type = "text/html",
+                               int statusCode = 200,
+                               std::string_view statusText = "OK",
+                               bool keepAlive = false,
+                               int retryAfterSeconds = 0) {
+        out.reserve(out.size() + body.size() + 192);
+        out += "HTTP/1.1 ";
+        out += std::to_string(statusCode);
+        out += ' ';
+        out += statusText;
+        out += "\r\nContent-Type: ";
+        out += type;
+        out += "; charset=utf-8\r\nContent-Length: ";
+        out += std::to_string(body.size());
+        out += "\r\nAccess-Control-Allow-Origin: *\r\n";
+        if (retryAfterSeconds > 0) {
+            out += "Retry-After: ";
+            out += std::to_string(retryAfterSeconds);
+            out += "\r\n";
+        }
+        out += keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+        out += body;
+    }
+
+    static std::string buildResponse(std::string_view body,
+                                     std::string_view type = "text/html",
+                                     int statusCode = 200,
+                                     std::string_view statusText = "OK",
+                                     bool keepAlive = false,
+                                     int retryAfterSeconds = 0) {
+        std::string response;
+        appendResponse(response, body, type, statusCode, statusText, keepAlive, retryAfterSeconds);
+        return response;
+    }
+
     static void sendResponse(SOCKET clientSock,
-                             const std::string& body,
-                             const std::string& type = "text/html",
+                             std::string_view body,
+                             std::string_view type = "text/html",
                              int statusCode = 200,
-                             const std::string& statusText = "OK") {
-        std::string response =
-            "HTTP/1.1 " + std::to_string(statusCode) + " " + statusText + "\r\n"
-            "Content-Type: " + type + "; charset=utf-8\r\n"
-            "Content-Length: " + std::to_string(body.size()) + "\r\n"
-            "Access-Control-Allow-Origin: *\r\n"
-            "Connection: close\r\n\r\n" +
-            body;
-
+                             std::string_view statusText = "OK",
+                             int retryAfterSeconds = 0) {
+        std::string response = buildResponse(body, type, statusCode, statusText, false, retryAfterSeconds);
         send(clientSock, response.c_str(), static_cast<int>(response.size()), 0);
     }
 
-    static std::string urlDecode(const std::string& value) {
-        std::ostringstream decoded;
+    // Dotted IPv4 text of a peer, used to tell clients apart.
+    static std::string addressText(const sockaddr_in& addr) {
+        char text[INET_ADDRSTRLEN] = {};
+        if (!inet_ntop(AF_INET, &addr.sin_addr, text, sizeof(text))) return "";
+        return text;
+    }
+
+    // Appends the decoded value to out. A % not followed by two hex digits
+    // is kept as is.
+    template <typename String>
+    static void urlDecodeInto(std::string_view value, String& out) {
         for (size_t i = 0; i < value.size(); i++) {
-            if (value[i] == '%' && i + 2 < value.size()) {
-                std::string hex = value.substr(i + 1, 2);
-                char ch = static_cast<char>(std::stoi(hex, nullptr, 16));
-                decoded << ch;
+            if (value[i] == '%' && i + 2 < value.size() && hexValue(value[i + 1]) >= 0 && hexValue(value[i + 2]) >= 0) {
+                out += static_cast<char>(hexValue(value[i + 1]) * 16 + hexValue(value[i + 2]));
                 i += 2;
             } else if (value[i] == '+') {
-                decoded << ' ';
+                out += ' ';
             } else {
-                decoded << value[i];
+                out += value[i];
             }
         }
-        return decoded.str();
     }
 
-    static std::unordered_map<std::string, std::string> parseQuery(const std::string& url) {
-        std::unordered_map<std::string, std::string> params;
+    static std::string urlDecode(std::string_view value) {
+        std::string decoded;
+        urlDecodeInto(value, decoded);
+        return decoded;
+    }
+
+    // Later repeats of a key win. Keys and values are allocated from memory.
+    static QueryParams parseQuery(std::string_view url,
+                                  std::pmr::memory_resource* memory = std::pmr::get_default_resource()) {
+        QueryParams params(memory);
         size_t queryStart = url.find('?');
-        if (queryStart == std::string::npos) return params;
+        if (queryStart == std::string_view::npos) return params;
 
-        std::string query = url.substr(queryStart + 1);
-        std::stringstream stream(query);
-        std::string pair;
-        while (std::getline(stream, pair, '&')) {
+        std::string_view query = url.substr(queryStart + 1);
+        while (!query.empty()) {
+            size_t amp = query.find('&');
+            std::string_view pair = query.substr(0, amp);
+            query = amp == std::string_view::npos ? std::string_view() : query.substr(amp + 1);
             size_t eq = pair.find('=');
-            if (eq == std::string::npos) continue;
-            std::string key = urlDecode(pair.substr(0, eq));
-            std::string value = urlDecode(pair.substr(eq + 1));
-            params[key] = value;
+            if (eq == std::string_view::npos) continue;
+            std::pmr::string key(memory);
+            std::pmr::string value(memory);
+            urlDecodeInto(pair.substr(0, eq), key);
+            urlDecodeInto(pair.substr(eq + 1), value);
+            params.insert_or_assign(std::move(key), std::move(value));
         }
         return params;
     }
@@ -108,6 +165,14 @@ public:
         size_t queryStart = url.find('?');
         return queryStart == std::string::npos ? url : url.substr(0, queryStart);
     }
+
+private:
+    static int hexValue(char ch) {
+        if (ch >= '0' && ch <= '9') return ch - '0';
+        if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+        if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+        return -1;
+    }
 };
 
 #endif
@@ -0,0 +1,361 @@
+#ifndef OBSERVATION_STORE_HPP
+#define OBSERVATION_STORE_HPP
+
+#include "MappedFile.hpp"
+#include "WeatherEngine.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct Observation {
+    int64_t time = 0;  // unix seconds, UTC
+    int32_t temp = 0;
+};
+
+enum class Rollup { Hour, Day, Month, Count };
+
+// Aggregate of every observation whose timestamp falls in one hour, day or
+// calendar month. start is the bucket number: hours or days since the epoch,
+// or months since January 1970.
+struct RollupBucket {
+    int64_t start = 0;
+    uint32_t count = 0;
+    int64_t sum = 0;
+    int32_t min = 0;
+    int32_t max = 0;
+
+    int mean() const {
+        return static_cast<int>(std::lround(static_cast<double>(sum) / count));
+    }
+};
+
+// Fixed-length rollup windows of one city, anchored at its newest observation.
+struct ObservedWindows {
+    int64_t newestTime = 0;
+    std::vector<RollupBucket> hourly;
+    std::vector<RollupBucket> weekly;
+    std::vector<RollupBucket> monthly;
+    std::vector<RollupBucket> yearly;
+};
+
+// Append-only history of one city. Points are packed into fixed-size chunks:
+// the first point is stored as is, every later one as a varint time delta and
+// a zigzag varint temperature delta, so a steady hourly feed costs about three
+// bytes per point. Each chunk keeps its time range so reads can skip it whole.
+class ObservationHistory {
+public:
+    struct Chunk {
+        int64_t firstTime = 0;
+        int64_t lastTime = 0;
+        int32_t firstTemp = 0;
+        int32_t lastTemp = 0;
+        uint32_t count = 0;
+        std::vector<uint8_t> deltas;
+    };
+
+    static constexpr size_t retainedBuckets[] = {24 * 7, 366, 120};
+    static constexpr int64_t maxTime = int64_t(1) << 40;  // keeps every delta a small varint
+
+    // Timestamps must lie in [0, maxTime] and must not go backwards; anything
+    // else is rejected.
+    bool append(int64_t time, int32_t temp, size_t chunkPoints, std::string* error = nullptr) {
+        if (time < 0 || time > maxTime) {
+            if (error) *error = "observation time " + std::to_string(time) + " is outside 0.." + std::to_string(maxTime);
+            return false;
+        }
+        if (!chunks.empty() && time < chunks.back().lastTime) {
+            if (error) *error = "observation at " + std::to_string(time) + " is older than the latest one";
+            return false;
+        }
+        if (chunks.empty() || chunks.back().count >= chunkPoints) {
+            Chunk chunk;
+            chunk.firstTime = chunk.lastTime = time;
+            chunk.firstTemp = chunk.lastTemp = temp;
+            chunk.count = 1;
+            chunks.push_back(std::move(chunk));
+        } else {
+            Chunk& chunk = chunks.back();
+            putVarint(chunk.deltas, static_cast<uint64_t>(time - chunk.lastTime));
+            putVarint(chunk.deltas, zigzag(static_cast<int64_t>(temp) - chunk.lastTemp));
+            chunk.lastTime = time;
+            chunk.lastTemp = temp;
+            chunk.count++;
+        }
+        points++;
+
+        const int64_t starts[] = {floorDiv(time, 3600), floorDiv(time, 86400), monthIndex(time)};
+        for (size_t r = 0; r < static_cast<size_t>(Rollup::Count); r++) {
+            std::deque<RollupBucket>& buckets = rollups[r];
+            if (buckets.empty() || buckets.back().start != starts[r]) {
+                buckets.push_back({starts[r], 0, 0, temp, temp});
+                if (buckets.size() > retainedBuckets[r]) buckets.pop_front();
+            }
+            RollupBucket& bucket = buckets.back();
+            bucket.count++;
+            bucket.sum += temp;
+            bucket.min = std::min(bucket.min, temp);
+            bucket.max = std::max(bucket.max, temp);
+        }
+        return true;
+    }
+
+    // Decodes the points with from <= time < to, skipping chunks outside it.
+    void range(int64_t from, int64_t to, std::vector<Observation>& out) const {
+        auto first = std::lower_bound(chunks.begin(), chunks.end(), from, [](const Chunk& chunk, int64_t t) {
+            return chunk.lastTime < t;
+        });
+        for (auto it = first; it != chunks.end() && it->firstTime < to; ++it) {
+            int64_t time = it->firstTime;
+            int64_t temp = it->firstTemp;
+            size_t at = 0;
+            for (uint32_t i = 0; i < it->count; i++) {
+                if (i > 0) {
+                    time += static_cast<int64_t>(getVarint(it->deltas, at));
+                    temp += unzigzag(getVarint(it->deltas, at));
+                }
+                if (time >= to) break;
+                if (time >= from) out.push_back({time, static_cast<int32_t>(temp)});
+            }
+        }
+    }
+
+    // The `slots` consecutive buckets of one rollup that end with the bucket
+    // holding the newest point, oldest first. Every slot has its start set;
+    // one without observations (or older than what is retained) has count 0.
+    std::vector<RollupBucket> window(Rollup rollup, size_t slots) const {
+        std::vector<RollupBucket> out(slots);
+        const std::deque<RollupBucket>& buckets = rollups[static_cast<size_t>(rollup)];
+        if (buckets.empty() || slots == 0) return out;
+        const int64_t first = buckets.back().start - static_cast<int64_t>(slots) + 1;
+        for (size_t i = 0; i < slots; i++) out[i].start = first + static_cast<int64_t>(i);
+        for (auto it = buckets.rbegin(); it != buckets.rend() && it->start >= first; ++it) {
+            out[static_cast<size_t>(it->start - first)] = *it;
+        }
+        return out;
+    }
+
+    int64_t newestTime() const { return chunks.empty() ? 0 : chunks.back().lastTime; }
+    size_t pointCount() const { return points; }
+    size_t chunkCount() const { return chunks.size(); }
+
+    size_t encodedBytes() const {
+        size_t bytes = 0;
+        for (const Chunk& chunk : chunks) bytes += sizeof(Chunk) + chunk.deltas.size();
+        return bytes;
+    }
+
+    static int64_t floorDiv(int64_t value, int64_t divisor) {
+        int64_t quotient = value / divisor;
+        return (value % divisor != 0 && value < 0) ? quotient - 1 : quotient;
+    }
+
+    // Months since 1970-01 for a unix timestamp (proleptic Gregorian, UTC).
+    static int64_t monthIndex(int64_t time) {
+        int64_t days = floorDiv(time, 86400) + 719468;
+        int64_t era = floorDiv(days, 146097);
+        int64_t dayOfEra = days - era * 146097;
+        int64_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+        int64_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+        int64_t shiftedMonth = (5 * dayOfYear + 2) / 153;
+        int64_t month = shiftedMonth < 10 ? shiftedMonth + 3 : shiftedMonth - 9;
+        int64_t year = yearOfEra + era * 400 + (month <= 2 ? 1 : 0);
+        return (year - 1970) * 12 + (month - 1);
+    }
+
+private:
+    std::vector<Chunk> chunks;
+    std::deque<RollupBucket> rollups[static_cast<size_t>(Rollup::Count)];
+    size_t points = 0;
+
+    static uint64_t zigzag(int64_t value) {
+        return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    }
+
+    static int64_t unzigzag(uint64_t value) {
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    static void putVarint(std::vector<uint8_t>& out, uint64_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    static uint64_t getVarint(const std::vector<uint8_t>& in, size_t& at) {
+        uint64_t value = 0;
+        for (int shift = 0; at < in.size(); shift += 7) {
+            uint8_t byte = in[at++];
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) break;
+        }
+        return value;
+    }
+};
+
+// Timestamped temperature observations for every city, kept outside the
+// immutable engine snapshots (like the request log) so ingestion never needs a
+// rebuild and history survives reloads. Cities are keyed by lower-cased name
+// and spread over independently locked shards. Each city holds at most
+// maxPoints observations; appends past that are rejected.
+class ObservationStore {
+public:
+    static constexpr size_t defaultMaxPoints = size_t(1) << 20;
+
+    explicit ObservationStore(size_t chunkPoints = 256, size_t maxPoints = defaultMaxPoints)
+        : chunkPoints(std::max<size_t>(1, chunkPoints)), maxPoints(std::max<size_t>(1, maxPoints)) {}
+
+    ObservationStore(const ObservationStore&) = delete;
+    ObservationStore& operator=(const ObservationStore&) = delete;
+
+    bool append(const std::string& city, int64_t time, int32_t temp, std::string* error = nullptr) {
+        const std::string key = keyOf(city);
+        Shard& shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.histories.find(key);
+        if (it == shard.histories.end()) {
+            ObservationHistory history;
+            if (!history.append(time, temp, chunkPoints, error)) return false;
+            shard.histories.emplace(key, std::move(history));
+            return true;
+        }
+        if (it->second.pointCount() >= maxPoints) {
+            if (error) *error = city + " already holds " + std::to_string(maxPoints) + " observations";
+            return false;
+        }
+        return it->second.append(time, temp, chunkPoints, error);
+    }
+
+    // Reads City,Timestamp,Temp rows (header first, timestamps in unix
+    // seconds). accept, when given, filters out unknown cities. Bad rows are
+    // reported per line and skipped.
+    bool loadCsv(const std::string& path,
+                 CsvLoadReport& report,
+                 const std::function<bool(const std::string&)>& accept = nullptr,
+                 std::string* error = nullptr) {
+        MappedFile file;
+        if (!file.open(path, error)) return false;
+
+        const char* at = file.data();
+        const char* end = at + file.size();
+        size_t lineNumber = 0;
+        while (at < end) {
+            const char* newline = static_cast<const char*>(std::memchr(at, '\n', static_cast<size_t>(end - at)));
+            std::string_view line(at, static_cast<size_t>((newline ? newline : end) - at));
+            at = newline ? newline + 1 : end;
+            if (++lineNumber == 1) continue;
+            if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            if (csv::trim(line).empty()) continue;
+
+            std::string_view cols[3];
+            bool quoted[3];
+            size_t count = csv::splitFields(line, cols, quoted, 3);
+
+            int64_t time = 0;
+            int32_t temp = 0;
+            std::string message;
+            const std::string city = csv::fieldText(cols[0], quoted[0]);
+            if (count < 3) {
+                message = "expected 3 columns, found " + std::to_string(count);
+            } else if (accept && !accept(city)) {
+                message = "unknown city " + city;
+            } else if (!csv::parseNumber(cols[1], time)) {
+                message = "invalid Timestamp value '" + std::string(cols[1]) + "'";
+            } else if (!csv::parseNumber(cols[2], temp)) {
+                message = "invalid Temp value '" + std::string(cols[2]) + "'";
+            } else if (append(city, time, temp, &message)) {
+                report.rowsLoaded++;
+                continue;
+            }
+            report.errors.push_back({lineNumber, message});
+        }
+        return true;
+    }
+
+    // The rollup windows behind a city's series, all ending at its newest
+    // observation: the 24 hours, 7 days, 30 days and 12 calendar months up to
+    // and including the one it falls in. Slots with no observations have
+    // count 0. False when there is no history.
+    bool windows(const std::string& city, ObservedWindows& out) const {
+        const std::string key = keyOf(city);
+        const Shard& shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.histories.find(key);
+        if (it == shard.histories.end()) return false;
+
+        const ObservationHistory& history = it->second;
+        out.newestTime = history.newestTime();
+        out.hourly = history.window(Rollup::Hour, 24);
+        out.weekly = history.window(Rollup::Day, 7);
+        out.monthly = history.window(Rollup::Day, 30);
+        out.yearly = history.window(Rollup::Month, 12);
+        return true;
+    }
+
+    std::vector<Observation> range(const std::string& city, int64_t from, int64_t to) const {
+        std::vector<Observation> out;
+        const std::string key = keyOf(city);
+        const Shard& shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.histories.find(key);
+        if (it != shard.histories.end()) it->second.range(from, to, out);
+        return out;
+    }
+
+    // The last `limit` buckets up to the newest observation; see window().
+    std::vector<RollupBucket> rollup(const std::string& city, Rollup rollup, size_t limit) const {
+        const std::string key = keyOf(city);
+        const Shard& shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.histories.find(key);
+        if (it == shard.histories.end()) return {};
+        return it->second.window(rollup, limit);
+    }
+
+    size_t pointLimit() const { return maxPoints; }
+
+    size_t pointCount(const std::string& city) const {
+        const std::string key = keyOf(city);
+        const Shard& shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.histories.find(key);
+        return it == shard.histories.end() ? 0 : it->second.pointCount();
+    }
+
+private:
+    static constexpr size_t shardCount = 16;
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, ObservationHistory> histories;
+    };
+
+    size_t chunkPoints;
+    size_t maxPoints;
+    Shard shards[shardCount];
+
+    Shard& shardFor(const std::string& key) {
+        return shards[std::hash<std::string> {}(key) % shardCount];
+    }
+
+    const Shard& shardFor(const std::string& key) const {
+        return shards[std::hash<std::string> {}(key) % shardCount];
+    }
+
+    static std::string keyOf(const std::string& name) {
+        return WeatherEngine::normalize(name);
+    }
+};
+
+#endif
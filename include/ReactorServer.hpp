@@ -0,0 +1,429 @@
+#ifndef REACTOR_SERVER_HPP
+#define REACTOR_SERVER_HPP
+
+#include "NetworkUtils.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef __linux__
+#include <cerrno>
+#include <fcntl.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#endif
+
+struct HttpRequestHead {
+    std::string method;
+    std::string url;
+    bool keepAlive = false;
+    std::string client;
+    // When the request became readable, as best the reactor can tell. The
+    // gap between this and the handler running is time spent queued behind
+    // other work.
+    std::chrono::steady_clock::time_point received;
+};
+
+// Multi-reactor HTTP front end (Linux only; see supported()). Every reactor
+// is a thread with its own epoll loop and its own SO_REUSEPORT listener on
+// the same port, so the kernel spreads new connections across reactors
+// instead of funnelling them through one accept queue, and a connection
+// stays on the reactor, and the core, that accepted it. Sockets are
+// non-blocking and HTTP/1.1 keep-alive, with pipelined requests answered in
+// order. Bodies are capped at maxBodyBytes, and connections that make no
+// progress either way for idleTimeoutMs are closed. The handler runs on the
+// reactor's thread, must be thread-safe, and appends the complete response
+// bytes to the connection's output buffer, which is reused from one response
+// to the next.
+class ReactorServer {
+public:
+    using Handler = std::function<void(size_t reactor, const HttpRequestHead& request, std::string& out)>;
+
+    struct Options {
+        int port = 8080;
+        int backlog = SOMAXCONN;
+        size_t reactors = 1;
+        bool pinThreads = true;
+        int idleTimeoutMs = 30000;
+    };
+
+    static constexpr size_t maxHeadBytes = 64 * 1024;
+    static constexpr size_t maxBodyBytes = 1024 * 1024;
+
+    static bool supported() {
+#ifdef __linux__
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    ReactorServer() = default;
+    ReactorServer(const ReactorServer&) = delete;
+    ReactorServer& operator=(const ReactorServer&) = delete;
+    ~ReactorServer() { stop(); }
+
+    // Binds every listener before any thread starts, so a taken port is
+    // reported here rather than from inside a reactor.
+    bool start(const Options& options, Handler handler, std::string* error = nullptr) {
+#ifdef __linux__
+        onRequest = std::move(handler);
+        idleTimeout = std::chrono::milliseconds(std::max(1, options.idleTimeoutMs));
+        stopping = false;
+        const size_t count = std::max<size_t>(1, options.reactors);
+        for (size_t i = 0; i < count; i++) {
+            int fd = openListener(options.port, options.backlog, error);
+            if (fd < 0) {
+                closeListeners();
+                return false;
+            }
+            listeners.push_back(fd);
+        }
+
+        const unsigned cpus = std::max(1u, std::thread::hardware_concurrency());
+        for (size_t i = 0; i < count; i++) {
+            threads.emplace_back([this, i] { runReactor(i, listeners[i]); });
+            if (options.pinThreads) {
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                CPU_SET(static_cast<int>(i % cpus), &set);
+                pthread_setaffinity_np(threads.back().native_handle(), sizeof(set), &set);
+            }
+        }
+        return true;
+#else
+        (void)options;
+        (void)handler;
+        if (error) *error = "multi-reactor mode needs epoll and SO_REUSEPORT (Linux)";
+        return false;
+#endif
+    }
+
+    // Reactors notice within one epoll timeout, close their connections and
+    // exit; stop() returns once all of them have.
+    void stop() {
+        stopping = true;
+        for (std::thread& thread : threads) {
+            if (thread.joinable()) thread.join();
+        }
+        threads.clear();
+        closeListeners();
+    }
+
+    size_t reactorCount() const { return listeners.size(); }
+
+    // Parses the request head in input[start, headEnd), where headEnd is the
+    // offset of the blank line. bodyLength is the declared Content-Length,
+    // which the caller skips over.
+    static bool parseHead(const std::string& input, size_t start, size_t headEnd, HttpRequestHead& head, size_t& bodyLength) {
+        size_t lineEnd = std::min(input.find("\r\n", start), headEnd);
+        size_t firstSpace = input.find(' ', start);
+        if (firstSpace == std::string::npos || firstSpace > lineEnd) return false;
+        size_t secondSpace = input.find(' ', firstSpace + 1);
+        if (secondSpace == std::string::npos || secondSpace > lineEnd) return false;
+        head.method = input.substr(start, firstSpace - start);
+        head.url = input.substr(firstSpace + 1, secondSpace - firstSpace - 1);
+        const bool http11 = input.compare(secondSpace + 1, lineEnd - secondSpace - 1, "HTTP/1.1") == 0;
+        head.keepAlive = http11;
+        bodyLength = 0;
+
+        for (size_t at = lineEnd + 2; at < headEnd;) {
+            size_t end = input.find("\r\n", at);
+            if (end == std::string::npos || end > headEnd) end = headEnd;
+            size_t colon = input.find(':', at);
+            if (colon != std::string::npos && colon < end) {
+                std::string name = lowercase(input.substr(at, colon - at));
+                size_t valueStart = input.find_first_not_of(" \t", colon + 1);
+                std::string value = valueStart < end ? lowercase(input.substr(valueStart, end - valueStart)) : "";
+                if (name == "connection") {
+                    if (value.find("close") != std::string::npos) head.keepAlive = false;
+                    if (value.find("keep-alive") != std::string::npos) head.keepAlive = true;
+                } else if (name == "content-length") {
+                    bodyLength = static_cast<size_t>(std::strtoull(value.c_str(), nullptr, 10));
+                }
+            }
+            at = end + 2;
+        }
+        return true;
+    }
+
+private:
+    Handler onRequest;
+    std::chrono::milliseconds idleTimeout {30000};
+    std::atomic<bool> stopping {false};
+    std::vector<int> listeners;
+    std::vector<std::thread> threads;
+
+    static std::string lowercase(std::string value) {
+        for (char& ch : value) ch = static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
+        return value;
+    }
+
+    void closeListeners() {
+        for (int fd : listeners) closesocket(fd);
+        listeners.clear();
+    }
+
+#ifdef __linux__
+    struct Connection {
+        std::string client;
+        std::string input;
+        std::string output;
+        size_t written = 0;
+        bool closeAfterWrite = false;
+        bool peerClosed = false;
+        uint32_t events = EPOLLIN | EPOLLRDHUP;
+        std::chrono::steady_clock::time_point lastActive;
+    };
+
+    static int openListener(int port, int backlog, std::string* error) {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            if (error) *error = "Failed to create server socket";
+            return -1;
+        }
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) != 0) {
+            if (error) *error = "SO_REUSEPORT is not available";
+            closesocket(fd);
+            return -1;
+        }
+
+        sockaddr_in addr {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+        addr.sin_addr.s_addr = INADDR_ANY;
+        if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            if (error) *error = "Could not bind to port " + std::to_string(port) + ". Is another server already running?";
+            closesocket(fd);
+            return -1;
+        }
+        if (listen(fd, backlog) != 0) {
+            if (error) *error = "Failed to listen on port " + std::to_string(port);
+            closesocket(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    void runReactor(size_t reactor, int listener) {
+        int epoll = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll < 0) return;
+        epoll_event event {};
+        event.events = EPOLLIN;
+        event.data.fd = listener;
+        epoll_ctl(epoll, EPOLL_CTL_ADD, listener, &event);
+
+        std::unordered_map<int, Connection> connections;
+        std::vector<epoll_event> ready(256);
+        std::vector<char> buffer(64 * 1024);
+
+        auto closeConnection = [&](int fd) {
+            epoll_ctl(epoll, EPOLL_CTL_DEL, fd, nullptr);
+            closesocket(fd);
+            connections.erase(fd);
+        };
+
+        auto passStarted = std::chrono::steady_clock::now();
+        auto lastSweep = passStarted;
+        auto acceptResumes = passStarted;
+        bool acceptPaused = false;
+        while (!stopping) {
+            // Events already pending when a pass ends arrived while it ran,
+            // so they count as queued since it began. Otherwise block, and
+            // whatever wakes the loop has only just arrived.
+            auto queuedSince = passStarted;
+            int count = epoll_wait(epoll, ready.data(), static_cast<int>(ready.size()), 0);
+            if (count <= 0) {
+                count = epoll_wait(epoll, ready.data(), static_cast<int>(ready.size()), acceptPaused ? 50 : 200);
+                queuedSince = std::chrono::steady_clock::now();
+            }
+            passStarted = std::chrono::steady_clock::now();
+            for (int i = 0; i < count; i++) {
+                const int fd = ready[i].data.fd;
+                if (fd == listener) {
+                    if (!acceptAll(epoll, listener, connections, passStarted)) {
+                        // Out of descriptors. The listener stays readable, so
+                        // stop watching it for a moment rather than spin on
+                        // accept; pending clients wait in the backlog.
+                        watchListener(epoll, listener, false);
+                        acceptPaused = true;
+                        acceptResumes = passStarted + std::chrono::milliseconds(100);
+                    }
+                    continue;
+                }
+                auto it = connections.find(fd);
+                if (it == connections.end()) continue;
+                Connection& connection = it->second;
+
+                bool open = !(ready[i].events & EPOLLERR);
+                if (open && (ready[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) && !connection.peerClosed) {
+                    open = readAvailable(fd, connection, buffer) && answer(reactor, connection, queuedSince);
+                    // A half-closed peer still gets the answers to what it sent.
+                    if (connection.peerClosed) connection.closeAfterWrite = true;
+                }
+                if (open) open = flush(epoll, fd, connection);
+                if (open && (ready[i].events & EPOLLHUP) && connection.written < connection.output.size()) open = false;
+                if (!open) closeConnection(fd);
+            }
+
+            if (acceptPaused && passStarted >= acceptResumes) {
+                watchListener(epoll, listener, true);
+                acceptPaused = false;
+            }
+
+            if (passStarted - lastSweep >= std::chrono::seconds(1)) {
+                lastSweep = passStarted;
+                std::vector<int> idle;
+                for (const auto& entry : connections) {
+                    if (passStarted - entry.second.lastActive >= idleTimeout) idle.push_back(entry.first);
+                }
+                for (int fd : idle) closeConnection(fd);
+            }
+        }
+
+        for (auto& entry : connections) closesocket(entry.first);
+        closesocket(epoll);
+    }
+
+    static void watchListener(int epoll, int listener, bool watch) {
+        epoll_event event {};
+        event.events = watch ? static_cast<uint32_t>(EPOLLIN) : 0u;
+        event.data.fd = listener;
+        epoll_ctl(epoll, EPOLL_CTL_MOD, listener, &event);
+    }
+
+    // Accepts until the backlog is empty. False when accepting failed for
+    // lack of descriptors or memory, which retrying at once cannot fix.
+    static bool acceptAll(int epoll, int listener, std::unordered_map<int, Connection>& connections,
+                          std::chrono::steady_clock::time_point now) {
+        while (true) {
+            sockaddr_in peer {};
+            socklen_t peerLength = sizeof(peer);
+            int fd = accept4(listener, reinterpret_cast<sockaddr*>(&peer), &peerLength, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) continue;
+                return errno != EMFILE && errno != ENFILE && errno != ENOBUFS && errno != ENOMEM;
+            }
+            int on = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+            epoll_event event {};
+            event.events = EPOLLIN | EPOLLRDHUP;
+            event.data.fd = fd;
+            if (epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event) != 0) {
+                closesocket(fd);
+                continue;
+            }
+            Connection& connection = connections[fd];
+            connection = Connection {};
+            connection.client = SimpleServer::addressText(peer);
+            connection.lastActive = now;
+        }
+    }
+
+    // False when the socket failed. End of input sets peerClosed; what was
+    // buffered before it is still answered.
+    static bool readAvailable(int fd, Connection& connection, std::vector<char>& buffer) {
+        while (true) {
+            ssize_t got = recv(fd, buffer.data(), buffer.size(), 0);
+            if (got > 0) {
+                connection.input.append(buffer.data(), static_cast<size_t>(got));
+                connection.lastActive = std::chrono::steady_clock::now();
+                continue;
+            }
+            if (got == 0) {
+                connection.peerClosed = true;
+                return true;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+    }
+
+    // Answers every complete request buffered so far. False when the input
+    // cannot be framed; the connection is then dropped.
+    bool answer(size_t reactor, Connection& connection, std::chrono::steady_clock::time_point queuedSince) {
+        size_t consumed = 0;
+        while (!connection.closeAfterWrite) {
+            size_t headEnd = connection.input.find("\r\n\r\n", consumed);
+            if (headEnd == std::string::npos) {
+                if (connection.input.size() - consumed > maxHeadBytes) {
+                    SimpleServer::appendResponse(connection.output, "Request header too large", "text/plain", 431,
+                                                 "Request Header Fields Too Large", false);
+                    connection.closeAfterWrite = true;
+                }
+                break;
+            }
+
+            HttpRequestHead head;
+            size_t bodyLength = 0;
+            if (!parseHead(connection.input, consumed, headEnd, head, bodyLength)) {
+                return false;
+            }
+            if (bodyLength > maxBodyBytes) {
+                SimpleServer::appendResponse(connection.output, "Request body too large", "text/plain", 413,
+                                             "Payload Too Large", false);
+                connection.closeAfterWrite = true;
+                consumed = connection.input.size();
+                break;
+            }
+            const size_t requestEnd = headEnd + 4 + bodyLength;
+            if (requestEnd > connection.input.size()) break;
+            head.client = connection.client;
+            head.received = queuedSince;
+
+            onRequest(reactor, head, connection.output);
+            connection.closeAfterWrite = !head.keepAlive;
+            consumed = requestEnd;
+        }
+        connection.input.erase(0, consumed);
+        return true;
+    }
+
+    // Writes what the socket takes and waits for EPOLLOUT for the rest.
+    // False when the connection is finished or broken.
+    static bool flush(int epoll, int fd, Connection& connection) {
+        while (connection.written < connection.output.size()) {
+            ssize_t sent = send(fd, connection.output.data() + connection.written,
+                                connection.output.size() - connection.written, MSG_NOSIGNAL);
+            if (sent > 0) {
+                connection.written += static_cast<size_t>(sent);
+                connection.lastActive = std::chrono::steady_clock::now();
+                continue;
+            }
+            if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            return false;
+        }
+
+        const bool pending = connection.written < connection.output.size();
+        if (!pending) {
+            connection.output.clear();
+            connection.written = 0;
+            if (connection.closeAfterWrite) return false;
+        }
+        // Once the peer has half-closed, input would only report EOF again.
+        const uint32_t events = (connection.peerClosed ? 0u : static_cast<uint32_t>(EPOLLIN | EPOLLRDHUP)) |
+                                (pending ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+        if (events != connection.events) {
+            epoll_event event {};
+            event.events = events;
+            event.data.fd = fd;
+            epoll_ctl(epoll, EPOLL_CTL_MOD, fd, &event);
+            connection.events = events;
+        }
+        return true;
+    }
+#endif
+};
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef REQUEST_ARENA_HPP
+#define REQUEST_ARENA_HPP
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+
+// Bump allocator for the short-lived memory one request makes and drops:
+// parsed query parameters, lookup keys, JSON fragments. Each worker thread
+// owns one, starting from a fixed block it keeps for its whole life;
+// allocating is a pointer bump, freeing is a no-op, and reset() hands
+// everything back at once when the request is done. A request that
+// outgrows the block spills into heap chunks, returned on the same reset.
+//
+// Nothing allocated here may outlive the request. Responses that are cached
+// or shared with other threads are copied to the heap first.
+class RequestArena {
+public:
+    static constexpr size_t blockBytes = 64 * 1024;
+
+    RequestArena()
+        : block(new std::byte[blockBytes]),
+          arena(block.get(), blockBytes, std::pmr::new_delete_resource()) {}
+
+    RequestArena(const RequestArena&) = delete;
+    RequestArena& operator=(const RequestArena&) = delete;
+
+    std::pmr::memory_resource* resource() { return &arena; }
+
+    void reset() { arena.release(); }
+
+    static RequestArena& local() {
+        thread_local RequestArena arena;
+        return arena;
+    }
+
+    // Resets the calling thread's arena when the request ends. Declare it
+    // before anything that allocates from the arena, so it is destroyed
+    // after all of them.
+    class Scope {
+    public:
+        Scope() : owner(local()) {}
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+        ~Scope() { owner.reset(); }
+
+        std::pmr::memory_resource* resource() { return owner.resource(); }
+
+    private:
+        RequestArena& owner;
+    };
+
+private:
+    std::unique_ptr<std::byte[]> block;
+    std::pmr::monotonic_buffer_resource arena;
+};
+
+#endif
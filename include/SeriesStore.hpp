@@ -0,0 +1,346 @@
+#ifndef SERIES_STORE_HPP
+#define SERIES_STORE_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define WEATHER_SERIES_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define WEATHER_SERIES_SSE2 1
+#endif
+
+enum class SeriesKind { Hourly, Weekly, Monthly, Yearly, Count };
+
+struct SeriesReduction {
+    int32_t min = std::numeric_limits<int32_t>::max();
+    int32_t max = std::numeric_limits<int32_t>::min();
+    int64_t sum = 0;
+    size_t count = 0;
+};
+
+// Vector kernels over contiguous int32 runs. The instruction set is picked at
+// compile time: AVX2 when the build enables it (WEATHER_SIMD_AVX2), SSE2 on any
+// other x86-64 build, plain loops elsewhere. The scalar versions are always
+// available so tests can check the vector paths against them.
+class SeriesKernels {
+public:
+    static const char* isa() {
+#if defined(WEATHER_SERIES_AVX2)
+        return "avx2";
+#elif defined(WEATHER_SERIES_SSE2)
+        return "sse2";
+#else
+        return "scalar";
+#endif
+    }
+
+    static void reduceScalar(const int32_t* values, size_t n, SeriesReduction& out) {
+        for (size_t i = 0; i < n; i++) {
+            out.min = std::min(out.min, values[i]);
+            out.max = std::max(out.max, values[i]);
+            out.sum += values[i];
+        }
+        out.count += n;
+    }
+
+    // Folds values[0, n) into out; sums are exact (64-bit lanes).
+    static void reduce(const int32_t* values, size_t n, SeriesReduction& out) {
+        size_t i = 0;
+#if defined(WEATHER_SERIES_AVX2)
+        if (n >= 8) {
+            __m256i lo = _mm256_set1_epi32(out.min);
+            __m256i hi = _mm256_set1_epi32(out.max);
+            __m256i sumA = _mm256_setzero_si256();
+            __m256i sumB = _mm256_setzero_si256();
+            for (; i + 8 <= n; i += 8) {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+                lo = _mm256_min_epi32(lo, v);
+                hi = _mm256_max_epi32(hi, v);
+                sumA = _mm256_add_epi64(sumA, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(v)));
+                sumB = _mm256_add_epi64(sumB, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(v, 1)));
+            }
+            alignas(32) int32_t lanes[16];
+            alignas(32) int64_t sums[8];
+            _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), lo);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(lanes + 8), hi);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(sums), sumA);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(sums + 4), sumB);
+            for (int k = 0; k < 8; k++) {
+                out.min = std::min(out.min, lanes[k]);
+                out.max = std::max(out.max, lanes[8 + k]);
+                out.sum += sums[k];
+            }
+        }
+#elif defined(WEATHER_SERIES_SSE2)
+        if (n >= 4) {
+            __m128i lo = _mm_set1_epi32(out.min);
+            __m128i hi = _mm_set1_epi32(out.max);
+            __m128i sumA = _mm_setzero_si128();
+            __m128i sumB = _mm_setzero_si128();
+            for (; i + 4 <= n; i += 4) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+                // SSE2 has no 32-bit min/max; select through a compare mask.
+                __m128i less = _mm_cmplt_epi32(v, lo);
+                lo = _mm_or_si128(_mm_and_si128(less, v), _mm_andnot_si128(less, lo));
+                __m128i greater = _mm_cmpgt_epi32(v, hi);
+                hi = _mm_or_si128(_mm_and_si128(greater, v), _mm_andnot_si128(greater, hi));
+                __m128i sign = _mm_srai_epi32(v, 31);
+                sumA = _mm_add_epi64(sumA, _mm_unpacklo_epi32(v, sign));
+                sumB = _mm_add_epi64(sumB, _mm_unpackhi_epi32(v, sign));
+            }
+            alignas(16) int32_t lanes[8];
+            alignas(16) int64_t sums[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(lanes), lo);
+            _mm_store_si128(reinterpret_cast<__m128i*>(lanes + 4), hi);
+            _mm_store_si128(reinterpret_cast<__m128i*>(sums), sumA);
+            _mm_store_si128(reinterpret_cast<__m128i*>(sums + 2), sumB);
+            for (int k = 0; k < 4; k++) {
+                out.min = std::min(out.min, lanes[k]);
+                out.max = std::max(out.max, lanes[4 + k]);
+                out.sum += sums[k];
+            }
+        }
+#endif
+        SeriesReduction tail;
+        reduceScalar(values + i, n - i, tail);
+        out.min = std::min(out.min, tail.min);
+        out.max = std::max(out.max, tail.max);
+        out.sum += tail.sum;
+        out.count += i + tail.count;
+    }
+
+    // acc[i] += add[i] - sub[i]; sub may be null. Drives the sliding window sums.
+    static void slide(int32_t* acc, const int32_t* add, const int32_t* sub, size_t n) {
+        size_t i = 0;
+#if defined(WEATHER_SERIES_AVX2)
+        for (; i + 8 <= n; i += 8) {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + i));
+            a = _mm256_add_epi32(a, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(add + i)));
+            if (sub) a = _mm256_sub_epi32(a, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sub + i)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + i), a);
+        }
+#elif defined(WEATHER_SERIES_SSE2)
+        for (; i + 4 <= n; i += 4) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc + i));
+            a = _mm_add_epi32(a, _mm_loadu_si128(reinterpret_cast<const __m128i*>(add + i)));
+            if (sub) a = _mm_sub_epi32(a, _mm_loadu_si128(reinterpret_cast<const __m128i*>(sub + i)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(acc + i), a);
+        }
+#endif
+        for (; i < n; i++) {
+            acc[i] += add[i] - (sub ? sub[i] : 0);
+        }
+    }
+};
+
+struct SeriesStats {
+    SeriesKind kind = SeriesKind::Hourly;
+    size_t cities = 0;
+    size_t fromSlot = 0;
+    size_t toSlot = 0;
+    size_t window = 1;
+    size_t samples = 0;
+    double min = 0.0;
+    double max = 0.0;
+    double mean = 0.0;
+    std::vector<std::pair<double, double>> percentiles;
+    std::vector<double> slotMeans;
+};
+
+// Columnar copy of every city's derived series: one 64-byte aligned array per
+// series kind, laid out slot-major so the values of all cities for one hour
+// (or day, or month) are contiguous and indexed by city id. Cross-city
+// aggregates then stream through memory instead of chasing one heap vector
+// per city.
+class SeriesStore {
+public:
+    static constexpr size_t kindCount = static_cast<size_t>(SeriesKind::Count);
+
+    static size_t slotCount(SeriesKind kind) {
+        static const size_t slots[] = {24, 7, 30, 12};
+        return slots[static_cast<size_t>(kind)];
+    }
+
+    static const char* kindName(SeriesKind kind) {
+        static const char* names[] = {"hourly", "weekly", "monthly", "yearly"};
+        return names[static_cast<size_t>(kind)];
+    }
+
+    static bool kindFromName(const std::string& name, SeriesKind& out) {
+        for (size_t k = 0; k < kindCount; k++) {
+            if (name == kindName(static_cast<SeriesKind>(k))) {
+                out = static_cast<SeriesKind>(k);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    size_t cityCount() const { return cities; }
+
+    void reserve(size_t cityCapacity) {
+        if (cityCapacity > stride) grow(cityCapacity);
+    }
+
+    // Series longer than the slot count are truncated; shorter ones are padded
+    // with their last value (0 when empty).
+    void assign(size_t cityId, SeriesKind kind, const std::vector<int>& values) {
+        assignWith(cityId, kind, [&](size_t slot) {
+            return values.empty() ? 0 : values[std::min(slot, values.size() - 1)];
+        });
+    }
+
+    // Writes valueAt(slot) for every slot of one city's series.
+    template <typename ValueAt>
+    void assignWith(size_t cityId, SeriesKind kind, ValueAt valueAt) {
+        if (cityId >= stride) grow(std::max<size_t>({64, stride * 2, cityId + 1}));
+        cities = std::max(cities, cityId + 1);
+        const size_t slots = slotCount(kind);
+        int32_t* column = columns[static_cast<size_t>(kind)].get();
+        for (size_t slot = 0; slot < slots; slot++) {
+            column[slot * stride + cityId] = static_cast<int32_t>(valueAt(slot));
+        }
+    }
+
+    // The values of every city for one slot, indexed by city id.
+    const int32_t* slot(SeriesKind kind, size_t index) const {
+        return columns[static_cast<size_t>(kind)].get() + index * stride;
+    }
+
+    int32_t value(SeriesKind kind, size_t index, size_t cityId) const {
+        return slot(kind, index)[cityId];
+    }
+
+    // Aggregates slots [fromSlot, toSlot) across all cities. With window > 1
+    // every value is first replaced by that city's trailing window-slot moving
+    // average, so slots before window - 1 are skipped. Percentiles use the
+    // nearest-rank definition.
+    SeriesStats stats(SeriesKind kind,
+                      size_t fromSlot,
+                      size_t toSlot,
+                      size_t window,
+                      const std::vector<double>& percentiles) const {
+        const size_t slots = slotCount(kind);
+        SeriesStats out;
+        out.kind = kind;
+        out.cities = cities;
+        out.window = std::max<size_t>(1, std::min(window, slots));
+        out.toSlot = std::min(toSlot, slots);
+        out.fromSlot = std::min(std::max(fromSlot, out.window - 1), out.toSlot);
+        if (cities == 0 || out.fromSlot == out.toSlot) return out;
+
+        const double scale = 1.0 / static_cast<double>(out.window);
+        SeriesReduction total;
+        forEachRow(kind, out.fromSlot, out.toSlot, out.window, [&](const int32_t* row) {
+            SeriesReduction slotTotal;
+            SeriesKernels::reduce(row, cities, slotTotal);
+            out.slotMeans.push_back(static_cast<double>(slotTotal.sum) / static_cast<double>(cities) * scale);
+            total.min = std::min(total.min, slotTotal.min);
+            total.max = std::max(total.max, slotTotal.max);
+            total.sum += slotTotal.sum;
+            total.count += slotTotal.count;
+        });
+        out.samples = total.count;
+        out.min = total.min * scale;
+        out.max = total.max * scale;
+        out.mean = static_cast<double>(total.sum) / static_cast<double>(total.count) * scale;
+        if (percentiles.empty()) return out;
+
+        // Values are small integers, so a counting pass over [min, max] ranks
+        // them without sorting; a wide range falls back to nth_element.
+        std::vector<size_t> ranks;
+        for (double p : percentiles) {
+            double clamped = std::min(100.0, std::max(0.0, p));
+            size_t rank = static_cast<size_t>(std::ceil(clamped / 100.0 * static_cast<double>(total.count)));
+            ranks.push_back(std::max<size_t>(1, rank) - 1);
+        }
+        const uint64_t range = static_cast<uint64_t>(static_cast<int64_t>(total.max) - total.min) + 1;
+        if (range <= (1u << 20)) {
+            std::vector<size_t> counts(static_cast<size_t>(range), 0);
+            forEachRow(kind, out.fromSlot, out.toSlot, out.window, [&](const int32_t* row) {
+                for (size_t c = 0; c < cities; c++) counts[static_cast<size_t>(row[c] - total.min)]++;
+            });
+            for (size_t i = 0; i < ranks.size(); i++) {
+                size_t seen = 0;
+                size_t bucket = 0;
+                while (seen + counts[bucket] <= ranks[i]) seen += counts[bucket++];
+                out.percentiles.push_back({percentiles[i], (total.min + static_cast<int64_t>(bucket)) * scale});
+            }
+        } else {
+            std::vector<int32_t> values;
+            values.reserve(total.count);
+            forEachRow(kind, out.fromSlot, out.toSlot, out.window, [&](const int32_t* row) {
+                values.insert(values.end(), row, row + cities);
+            });
+            for (size_t i = 0; i < ranks.size(); i++) {
+                std::nth_element(values.begin(), values.begin() + static_cast<std::ptrdiff_t>(ranks[i]), values.end());
+                out.percentiles.push_back({percentiles[i], values[ranks[i]] * scale});
+            }
+        }
+        return out;
+    }
+
+private:
+    struct AlignedFree {
+        void operator()(int32_t* p) const {
+            ::operator delete[](p, std::align_val_t(64));
+        }
+    };
+    using Column = std::unique_ptr<int32_t[], AlignedFree>;
+
+    Column columns[kindCount];
+    size_t stride = 0;
+    size_t cities = 0;
+
+    static Column allocate(size_t count) {
+        return Column(static_cast<int32_t*>(::operator new[](count * sizeof(int32_t), std::align_val_t(64))));
+    }
+
+    // Rows are padded to a multiple of 16 ints so each one starts on a cache line.
+    void grow(size_t cityCapacity) {
+        const size_t nextStride = (cityCapacity + 15) & ~static_cast<size_t>(15);
+        for (size_t k = 0; k < kindCount; k++) {
+            const size_t slots = slotCount(static_cast<SeriesKind>(k));
+            Column next = allocate(slots * nextStride);
+            std::memset(next.get(), 0, slots * nextStride * sizeof(int32_t));
+            for (size_t s = 0; s < slots && cities > 0; s++) {
+                std::memcpy(next.get() + s * nextStride, columns[k].get() + s * stride, cities * sizeof(int32_t));
+            }
+            columns[k] = std::move(next);
+        }
+        stride = nextStride;
+    }
+
+    // Calls visit(row) for every slot in [fromSlot, toSlot). With window > 1 the
+    // row holds per-city sums of the trailing window, kept up to date by adding
+    // the entering slot and subtracting the leaving one.
+    template <typename Visit>
+    void forEachRow(SeriesKind kind, size_t fromSlot, size_t toSlot, size_t window, Visit visit) const {
+        if (window == 1) {
+            for (size_t s = fromSlot; s < toSlot; s++) visit(slot(kind, s));
+            return;
+        }
+        std::vector<int32_t> sums(cities, 0);
+        for (size_t s = fromSlot + 1 - window; s < fromSlot; s++) {
+            SeriesKernels::slide(sums.data(), slot(kind, s), nullptr, cities);
+        }
+        for (size_t s = fromSlot; s < toSlot; s++) {
+            SeriesKernels::slide(sums.data(), slot(kind, s), s > fromSlot ? slot(kind, s - window) : nullptr, cities);
+            visit(sums.data());
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef SINGLE_FLIGHT_HPP
+#define SINGLE_FLIGHT_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+// Coalesces concurrent identical computations. The first caller for a key
+// becomes the leader and computes; callers that arrive while it is running
+// wait for its result instead of repeating the work, and all of them share
+// the one value it produced. Nothing is kept once the leader finishes, so
+// this is not a cache: a call that starts afterwards computes again.
+//
+// Waiting is bounded two ways. At most maxWaiters callers queue behind one
+// leader, and each waits at most timeout. A caller turned away by either
+// bound computes on its own, so a slow or stuck leader costs its followers
+// time but never an answer.
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class SingleFlight {
+public:
+    enum class Outcome { Led, Joined, Overflowed, TimedOut };
+
+    SingleFlight(size_t maxWaiters, std::chrono::milliseconds timeout)
+        : maxWaiters(maxWaiters), timeout(timeout) {}
+
+    SingleFlight(const SingleFlight&) = delete;
+    SingleFlight& operator=(const SingleFlight&) = delete;
+
+    // If the leader's compute() throws, the exception is rethrown to every
+    // caller that joined it.
+    template <typename Compute>
+    std::shared_ptr<const Value> run(const Key& key, Compute compute, Outcome* outcome = nullptr) {
+        std::unique_lock<std::mutex> lock(mutex);
+        auto it = calls.find(key);
+        if (it == calls.end()) {
+            std::shared_ptr<Call> call = std::make_shared<Call>();
+            calls.emplace(key, call);
+            lock.unlock();
+            if (outcome) *outcome = Outcome::Led;
+            return lead(key, *call, compute);
+        }
+
+        std::shared_ptr<Call> call = it->second;
+        if (call->waiters >= maxWaiters) {
+            lock.unlock();
+            if (outcome) *outcome = Outcome::Overflowed;
+            return std::make_shared<const Value>(compute());
+        }
+        call->waiters++;
+        bool finished = call->finishedSignal.wait_for(lock, timeout, [&] { return call->done; });
+        call->waiters--;
+        if (!finished) {
+            lock.unlock();
+            if (outcome) *outcome = Outcome::TimedOut;
+            return std::make_shared<const Value>(compute());
+        }
+        if (outcome) *outcome = Outcome::Joined;
+        if (call->error) std::rethrow_exception(call->error);
+        return call->value;
+    }
+
+    size_t inFlight() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return calls.size();
+    }
+
+    size_t waiting(const Key& key) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = calls.find(key);
+        return it == calls.end() ? 0 : it->second->waiters;
+    }
+
+private:
+    struct Call {
+        std::condition_variable finishedSignal;
+        bool done = false;
+        size_t waiters = 0;
+        std::shared_ptr<const Value> value;
+        std::exception_ptr error;
+    };
+
+    size_t maxWaiters;
+    std::chrono::milliseconds timeout;
+    mutable std::mutex mutex;
+    std::unordered_map<Key, std::shared_ptr<Call>, Hash> calls;
+
+    template <typename Compute>
+    std::shared_ptr<const Value> lead(const Key& key, Call& call, Compute& compute) {
+        std::shared_ptr<const Value> value;
+        std::exception_ptr error;
+        try {
+            value = std::make_shared<const Value>(compute());
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            call.value = value;
+            call.error = error;
+            call.done = true;
+            calls.erase(key);
+        }
+        call.finishedSignal.notify_all();
+        if (error) std::rethrow_exception(error);
+        return value;
+    }
+};
+
+#endif
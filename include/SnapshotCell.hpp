@@ -0,0 +1,80 @@
+#ifndef SNAPSHOT_CELL_HPP
+#define SNAPSHOT_CELL_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+// Publishes immutable snapshots of T, RCU style. A writer builds a complete
+// new T off to the side and publish()es it; readers acquire() a shared_ptr
+// that pins the version they saw until they drop it, so a swap never pulls
+// data out from under an in-flight request.
+//
+// The reader fast path is one atomic load of the generation counter plus a
+// reference-count increment on a per-thread cached pointer; the shared_ptr
+// atomic (which may be lock-based) is only touched once per thread after each
+// publish. A thread's cached pointer keeps the previous snapshot alive until
+// that thread's next acquire().
+//
+// Each snapshot is published together with its generation number, so a
+// reader that needs both (to key work by version) gets a matching pair from
+// acquireVersioned() even when a publish lands in between.
+template <typename T>
+class SnapshotCell {
+public:
+    struct Versioned {
+        std::shared_ptr<const T> value;
+        uint64_t generation = 0;
+    };
+
+    SnapshotCell() = default;
+    SnapshotCell(const SnapshotCell&) = delete;
+    SnapshotCell& operator=(const SnapshotCell&) = delete;
+
+    void publish(std::shared_ptr<const T> next) {
+        std::lock_guard<std::mutex> lock(publishing);
+        const uint64_t generation = generationCounter.load(std::memory_order_relaxed) + 1;
+        auto entry = std::make_shared<const Versioned>(Versioned {std::move(next), generation});
+        std::atomic_store_explicit(&current, std::move(entry), std::memory_order_release);
+        generationCounter.store(generation, std::memory_order_release);
+    }
+
+    std::shared_ptr<const T> acquire() const {
+        return pinned().value;
+    }
+
+    Versioned acquireVersioned() const {
+        return pinned();
+    }
+
+    uint64_t generation() const {
+        return generationCounter.load(std::memory_order_acquire);
+    }
+
+private:
+    std::shared_ptr<const Versioned> current;
+    std::atomic<uint64_t> generationCounter {0};
+    std::mutex publishing;
+
+    const Versioned& pinned() const {
+        static const Versioned empty;
+        struct Cached {
+            const SnapshotCell* owner = nullptr;
+            uint64_t generation = 0;
+            std::shared_ptr<const Versioned> entry;
+        };
+        thread_local Cached cached;
+
+        uint64_t now = generationCounter.load(std::memory_order_acquire);
+        if (cached.owner != this || cached.generation != now) {
+            cached.entry = std::atomic_load_explicit(&current, std::memory_order_acquire);
+            cached.owner = this;
+            cached.generation = now;
+        }
+        return cached.entry ? *cached.entry : empty;
+    }
+};
+
+#endif
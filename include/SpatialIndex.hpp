@@ -0,0 +1,192 @@
+#ifndef SPATIAL_INDEX_HPP
+#define SPATIAL_INDEX_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <queue>
+#include <utility>
+#include <vector>
+
+// Static spatial index over (lat, lon) points identified by dense ids. Two
+// implicit k-d trees share nothing but the ids:
+//   - a 3D tree over unit vectors on the sphere answers nearest-neighbour
+//     queries exactly (chord length orders points the same way great-circle
+//     distance does, and has no trouble at the antimeridian or the poles);
+//   - a 2D tree over raw lat/lon answers viewport (bounding-box) queries.
+// Each tree is a flat array sorted in place by recursive median splits, so a
+// node is just the middle of its index range and no child pointers are stored.
+// Rebuild it whenever the point set changes.
+class SpatialIndex {
+public:
+    static constexpr double earthRadiusKm = 6371.0;
+
+    struct Neighbor {
+        uint32_t id = 0;
+        double distanceKm = 0.0;
+    };
+
+    void build(const std::vector<double>& lats, const std::vector<double>& lons) {
+        const size_t n = std::min(lats.size(), lons.size());
+        sphere.assign(n, {});
+        flat.assign(n, {});
+        for (size_t i = 0; i < n; i++) {
+            double lat = degToRad(lats[i]);
+            double lon = degToRad(lons[i]);
+            sphere[i] = {{std::cos(lat) * std::cos(lon), std::cos(lat) * std::sin(lon), std::sin(lat)}, static_cast<uint32_t>(i), 0};
+            flat[i] = {{lats[i], lons[i]}, static_cast<uint32_t>(i), 0};
+        }
+        buildTree(sphere, 0, n);
+        buildTree(flat, 0, n);
+    }
+
+    size_t size() const { return sphere.size(); }
+
+    // The k points closest to (lat, lon) by great-circle distance, nearest first.
+    std::vector<Neighbor> nearest(double lat, double lon, size_t k) const {
+        std::vector<Neighbor> out;
+        if (k == 0 || sphere.empty()) return out;
+        const double latRad = degToRad(lat);
+        const double lonRad = degToRad(lon);
+        const double query[3] = {std::cos(latRad) * std::cos(lonRad), std::cos(latRad) * std::sin(lonRad), std::sin(latRad)};
+
+        std::priority_queue<std::pair<double, uint32_t>> best;
+        searchNearest(0, sphere.size(), query, k, best);
+        out.resize(best.size());
+        for (size_t i = out.size(); i-- > 0;) {
+            double chord = std::sqrt(best.top().first);
+            out[i] = {best.top().second, 2.0 * earthRadiusKm * std::asin(std::min(1.0, chord / 2.0))};
+            best.pop();
+        }
+        return out;
+    }
+
+    // Ids of the points inside the box, at most limit of them. A box whose
+    // minLon is greater than its maxLon wraps across the antimeridian.
+    void withinBox(double minLat, double maxLat, double minLon, double maxLon,
+                   std::vector<uint32_t>& out, size_t limit = SIZE_MAX) const {
+        if (minLon > maxLon) {
+            withinBox(minLat, maxLat, minLon, 180.0, out, limit);
+            withinBox(minLat, maxLat, -180.0, maxLon, out, limit);
+            return;
+        }
+        const double low[2] = {minLat, minLon};
+        const double high[2] = {maxLat, maxLon};
+        searchBox(0, flat.size(), low, high, out, limit);
+    }
+
+private:
+    template <size_t Dims>
+    struct Node {
+        double point[Dims];
+        uint32_t id;
+        uint8_t axis;
+    };
+
+    static constexpr size_t leafSize = 8;
+
+    std::vector<Node<3>> sphere;
+    std::vector<Node<2>> flat;
+
+    static double degToRad(double deg) {
+        return deg * 3.14159265358979323846 / 180.0;
+    }
+
+    // Splits on the axis with the widest spread, which keeps cells compact
+    // when the points only cover a small part of the globe.
+    template <size_t Dims>
+    static void buildTree(std::vector<Node<Dims>>& nodes, size_t lo, size_t hi) {
+        if (hi - lo <= leafSize) return;
+        double minValue[Dims];
+        double maxValue[Dims];
+        std::fill(minValue, minValue + Dims, INFINITY);
+        std::fill(maxValue, maxValue + Dims, -INFINITY);
+        for (size_t i = lo; i < hi; i++) {
+            for (size_t d = 0; d < Dims; d++) {
+                minValue[d] = std::min(minValue[d], nodes[i].point[d]);
+                maxValue[d] = std::max(maxValue[d], nodes[i].point[d]);
+            }
+        }
+        uint8_t axis = 0;
+        for (size_t d = 1; d < Dims; d++) {
+            if (maxValue[d] - minValue[d] > maxValue[axis] - minValue[axis]) axis = static_cast<uint8_t>(d);
+        }
+
+        const size_t mid = lo + (hi - lo) / 2;
+        std::nth_element(nodes.begin() + static_cast<std::ptrdiff_t>(lo), nodes.begin() + static_cast<std::ptrdiff_t>(mid),
+                         nodes.begin() + static_cast<std::ptrdiff_t>(hi), [axis](const Node<Dims>& a, const Node<Dims>& b) {
+                             return a.point[axis] < b.point[axis];
+                         });
+        nodes[mid].axis = axis;
+        buildTree(nodes, lo, mid);
+        buildTree(nodes, mid + 1, hi);
+    }
+
+    static double distanceSquared(const double* a, const double* b) {
+        double dx = a[0] - b[0];
+        double dy = a[1] - b[1];
+        double dz = a[2] - b[2];
+        return dx * dx + dy * dy + dz * dz;
+    }
+
+    void offer(const Node<3>& node, const double* query, size_t k, std::priority_queue<std::pair<double, uint32_t>>& best) const {
+        double d = distanceSquared(node.point, query);
+        if (best.size() < k) {
+            best.push({d, node.id});
+        } else if (d < best.top().first) {
+            best.pop();
+            best.push({d, node.id});
+        }
+    }
+
+    void searchNearest(size_t lo, size_t hi, const double* query, size_t k,
+                       std::priority_queue<std::pair<double, uint32_t>>& best) const {
+        if (hi - lo <= leafSize) {
+            for (size_t i = lo; i < hi; i++) offer(sphere[i], query, k, best);
+            return;
+        }
+        const size_t mid = lo + (hi - lo) / 2;
+        const Node<3>& node = sphere[mid];
+        offer(node, query, k, best);
+
+        double diff = query[node.axis] - node.point[node.axis];
+        bool leftFirst = diff < 0;
+        if (leftFirst) {
+            searchNearest(lo, mid, query, k, best);
+        } else {
+            searchNearest(mid + 1, hi, query, k, best);
+        }
+        if (best.size() < k || diff * diff < best.top().first) {
+            if (leftFirst) {
+                searchNearest(mid + 1, hi, query, k, best);
+            } else {
+                searchNearest(lo, mid, query, k, best);
+            }
+        }
+    }
+
+    static bool inside(const Node<2>& node, const double* low, const double* high) {
+        return node.point[0] >= low[0] && node.point[0] <= high[0] &&
+               node.point[1] >= low[1] && node.point[1] <= high[1];
+    }
+
+    void searchBox(size_t lo, size_t hi, const double* low, const double* high,
+                   std::vector<uint32_t>& out, size_t limit) const {
+        if (out.size() >= limit) return;
+        if (hi - lo <= leafSize) {
+            for (size_t i = lo; i < hi && out.size() < limit; i++) {
+                if (inside(flat[i], low, high)) out.push_back(flat[i].id);
+            }
+            return;
+        }
+        const size_t mid = lo + (hi - lo) / 2;
+        const Node<2>& node = flat[mid];
+        if (inside(node, low, high) && out.size() < limit) out.push_back(node.id);
+        if (low[node.axis] <= node.point[node.axis]) searchBox(lo, mid, low, high, out, limit);
+        if (high[node.axis] >= node.point[node.axis]) searchBox(mid + 1, hi, low, high, out, limit);
+    }
+};
+
+#endif
@@ -1,16 +1,29 @@
 #ifndef WEATHER_ENGINE_HPP
 #define WEATHER_ENGINE_HPP
 
+#include "LruCache.hpp"
+#include "MappedFile.hpp"
+#include "Metrics.hpp"
+#include "SeriesStore.hpp"
+#include "SpatialIndex.hpp"
+
 #include <algorithm>
+#include <atomic>
 #include <cctype>
+#include <charconv>
 #include <cmath>
+#include <cstring>
 #include <functional>
 #include <fstream>
 #include <limits>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
 #include <queue>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
@@ -25,6 +38,7 @@ struct DailyForecast {
 };
 
 struct City {
+    size_t id = 0;  // dense index into the engine's columnar stores
     std::string name;
     double lat = 0.0;
     double lon = 0.0;
@@ -46,6 +60,7 @@ struct RouteEdge {
     std::string city;
     double distanceKm = 0.0;
     int weatherRisk = 0;
+    size_t cityId = 0;
 };
 
 struct Alert {
@@ -58,15 +73,199 @@ struct Alert {
     }
 };
 
+struct CsvRowError {
+    size_t line = 0;
+    std::string message;
+};
+
+struct CsvLoadReport {
+    size_t rowsLoaded = 0;
+    std::vector<CsvRowError> errors;
+};
+
+// One undirected road segment. A negative risk or distance means "derive it
+// from the two cities", exactly like the 2-argument addRoute().
+struct RouteSpec {
+    std::string from;
+    std::string to;
+    int weatherRisk = -1;
+    double distanceKm = -1.0;
+};
+
+struct NearbyCity {
+    const City* city = nullptr;
+    double distanceKm = 0.0;
+};
+
+// Series and forecast a loaded city did not carry explicitly; built on first
+// access and kept in the engine's bounded LRU keyed by city id.
+struct DerivedSeries {
+    std::vector<int> hourly;
+    std::vector<int> weekly;
+    std::vector<int> monthly;
+    std::vector<int> yearly;
+    std::vector<DailyForecast> forecast;
+};
+
+// Read-only view of one stored city plus its series, explicit or derived.
+// Nothing is copied: the view points into the engine, so it is only valid
+// while that engine is alive (hold the snapshot's shared_ptr). The derived
+// series are pinned by the view and survive eviction from the cache.
+class CityView {
+public:
+    CityView() = default;
+    CityView(const City* record, std::shared_ptr<const DerivedSeries> derived)
+        : record(record), derived(std::move(derived)) {}
+
+    explicit operator bool() const { return record != nullptr; }
+    const City& city() const { return *record; }
+
+    const std::vector<int>& series(SeriesKind kind) const {
+        const std::vector<int>* own[] = {&record->hourlyData, &record->weeklyData, &record->monthlyData, &record->yearlyData};
+        const std::vector<int>& value = *own[static_cast<size_t>(kind)];
+        if (!value.empty() || !derived) return value;
+        const std::vector<int>* built[] = {&derived->hourly, &derived->weekly, &derived->monthly, &derived->yearly};
+        return *built[static_cast<size_t>(kind)];
+    }
+
+    const std::vector<DailyForecast>& forecast() const {
+        return record->tenDayForecast.empty() && derived ? derived->forecast : record->tenDayForecast;
+    }
+
+private:
+    const City* record = nullptr;
+    std::shared_ptr<const DerivedSeries> derived;
+};
+
 struct RouteResult {
     bool found = false;
     int totalRisk = 0;
     double totalDistanceKm = 0.0;
     std::vector<std::string> path;
+    int departDay = -1;   // forecast days; set by the time-dependent search only
+    int arrivalDay = -1;
+};
+
+// One city settled by a bounded search: its cost from the origin and the
+// city it was reached from (nullptr for the origin itself).
+struct ReachableCity {
+    const City* city = nullptr;
+    const City* via = nullptr;
+    int risk = 0;
+    double distanceKm = 0.0;
+    size_t hops = 0;
 };
 
+// Allocation-free CSV helpers shared by the city, route and observation
+// loaders.
+namespace csv {
+inline std::string_view trim(std::string_view value) {
+    size_t start = 0;
+    while (start < value.size() && std::isspace(static_cast<unsigned char>(value[start]))) start++;
+
+    size_t end = value.size();
+    while (end > start && std::isspace(static_cast<unsigned char>(value[end - 1]))) end--;
+
+    return value.substr(start, end - start);
+}
+
+template <typename T>
+bool parseNumber(std::string_view text, T& out) {
+    if (!text.empty() && text.front() == '+') text.remove_prefix(1);
+    auto result = std::from_chars(text.data(), text.data() + text.size(), out);
+    return result.ec == std::errc() && result.ptr == text.data() + text.size() && !text.empty();
+}
+
+// Splits one CSV row into at most maxCols trimmed views; returns the total
+// number of fields seen. quoted[i] records whether field i contained quotes.
+inline size_t splitFields(std::string_view line, std::string_view* cols, bool* quoted, size_t maxCols) {
+    size_t count = 0;
+    size_t fieldStart = 0;
+    bool inQuotes = false;
+    for (size_t i = 0; i < maxCols; i++) quoted[i] = false;
+    for (size_t i = 0; i <= line.size(); i++) {
+        if (i < line.size() && line[i] == '"') {
+            inQuotes = !inQuotes;
+            if (count < maxCols) quoted[count] = true;
+        } else if (i == line.size() || (line[i] == ',' && !inQuotes)) {
+            if (count < maxCols) cols[count] = trim(line.substr(fieldStart, i - fieldStart));
+            count++;
+            fieldStart = i + 1;
+        }
+    }
+    return count;
+}
+
+inline std::string fieldText(std::string_view col, bool quoted) {
+    std::string out(col);
+    if (quoted) out.erase(std::remove(out.begin(), out.end(), '"'), out.end());
+    return std::string(trim(out));
+}
+}  // namespace csv
+
 class WeatherEngine {
 private:
+    friend class EngineSnapshot;
+
+    // Scratch arrays for graph searches, indexed by city id and reused by
+    // every search on the same thread. An entry belongs to the current search
+    // only when its stamp matches, so starting a search clears nothing.
+    struct SearchWorkspace {
+        std::vector<uint32_t> stamp;
+        std::vector<int> risk;
+        std::vector<double> distance;
+        std::vector<size_t> parent;
+        std::vector<size_t> hops;
+        std::vector<std::pair<double, size_t>> heap;
+        uint32_t current = 0;
+
+        void begin(size_t cityCount) {
+            if (stamp.size() < cityCount) {
+                stamp.resize(cityCount, 0);
+                risk.resize(cityCount);
+                distance.resize(cityCount);
+                parent.resize(cityCount);
+                hops.resize(cityCount);
+            }
+            heap.clear();
+            if (++current == 0) {
+                std::fill(stamp.begin(), stamp.end(), 0);
+                current = 1;
+            }
+        }
+
+        bool seen(size_t id) const { return stamp[id] == current; }
+
+        void push(size_t id, int costRisk, double costKm, size_t from, size_t steps, double key) {
+            stamp[id] = current;
+            risk[id] = costRisk;
+            distance[id] = costKm;
+            parent[id] = from;
+            hops[id] = steps;
+            heap.push_back({key, id});
+            std::push_heap(heap.begin(), heap.end(), std::greater<std::pair<double, size_t>>());
+        }
+
+        // Next live entry, skipping those a cheaper push has superseded.
+        bool pop(size_t& id, bool byDistance) {
+            while (!heap.empty()) {
+                std::pop_heap(heap.begin(), heap.end(), std::greater<std::pair<double, size_t>>());
+                const std::pair<double, size_t> item = heap.back();
+                heap.pop_back();
+                if (item.first == (byDistance ? distance[item.second] : static_cast<double>(risk[item.second]))) {
+                    id = item.second;
+                    return true;
+                }
+            }
+            return false;
+        }
+    };
+
+    static SearchWorkspace& searchWorkspace() {
+        static thread_local SearchWorkspace workspace;
+        return workspace;
+    }
+
     struct TrieNode {
         bool terminal = false;
         std::vector<std::string> names;
@@ -78,23 +277,36 @@ private:
     std::priority_queue<Alert> alertSystem;
     std::vector<std::string> requestLogStack;
     std::unique_ptr<TrieNode> trieRoot = std::make_unique<TrieNode>();
-
-    static std::string trim(const std::string& value) {
-        size_t start = 0;
-        while (start < value.size() && std::isspace(static_cast<unsigned char>(value[start]))) start++;
-
-        size_t end = value.size();
-        while (end > start && std::isspace(static_cast<unsigned char>(value[end - 1]))) end--;
-
-        return value.substr(start, end - start);
-    }
-
-    static std::string normalize(const std::string& value) {
-        std::string out = trim(value);
-        std::transform(out.begin(), out.end(), out.begin(), [](unsigned char ch) {
+    SeriesStore seriesStore;
+    std::vector<const City*> citiesById;
+    std::vector<const std::vector<RouteEdge>*> edgesById;
+    mutable std::vector<const City*> nameOrder;
+    mutable std::vector<int> dayPenalty;  // forecastDays entries per city id
+    mutable std::vector<const City*> hottestOrder;
+    mutable std::vector<const City*> coldestOrder;
+    mutable SpatialIndex spatialIndex;
+    mutable std::atomic<bool> indexStale {false};
+    mutable std::mutex indexMutex;
+
+    static constexpr size_t defaultDerivedCacheCapacity = 4096;
+    std::unique_ptr<LruCache<size_t, DerivedSeries>> derivedCache =
+        std::make_unique<LruCache<size_t, DerivedSeries>>(defaultDerivedCacheCapacity);
+
+    static void normalizeInto(std::string_view value, std::string& out) {
+        value = csv::trim(value);
+        out.resize(value.size());
+        std::transform(value.begin(), value.end(), out.begin(), [](unsigned char ch) {
             return static_cast<char>(std::tolower(ch));
         });
-        return out;
+    }
+
+    // normalize() into a per-thread buffer, for lookups that need one key at
+    // a time: once the buffer has grown to fit, they stop allocating. The
+    // reference is only good until the thread's next lookup.
+    static const std::string& lookupKey(std::string_view name) {
+        thread_local std::string key;
+        normalizeInto(name, key);
+        return key;
     }
 
     static std::vector<std::string> splitCsvLine(const std::string& line) {
@@ -117,43 +329,117 @@ private:
         return cols;
     }
 
-    static std::vector<int> buildHourlySeries(int temp) {
-        std::vector<int> data;
-        for (int hour = 0; hour < 24; hour++) {
-            double wave = std::sin((hour - 6) * 3.14159265 / 12.0);
-            data.push_back(temp + static_cast<int>(std::round(wave * 4)));
+    // Non-throwing counterpart of splitCsvLine + stod/stoi for one data row.
+    static bool parseCityRow(std::string_view line, City& city, std::string& message) {
+        static const char* columnNames[] = {"City", "Lat", "Lon", "Temp", "Condition",
+                                            "Wind", "Humidity", "AQI", "Rain", "WindDir"};
+        std::string_view cols[10];
+        bool quoted[10];
+        size_t count = csv::splitFields(line, cols, quoted, 10);
+        if (count < 10) {
+            message = "expected 10 columns, found " + std::to_string(count);
+            return false;
+        }
+
+        auto text = [&](size_t index) {
+            return csv::fieldText(cols[index], quoted[index]);
+        };
+        auto fail = [&](size_t index) {
+            message = "invalid " + std::string(columnNames[index]) + " value '" + std::string(cols[index]) + "'";
+            return false;
+        };
+
+        city.name = text(0);
+        if (city.name.empty()) {
+            message = "empty City value";
+            return false;
+        }
+        if (!csv::parseNumber(cols[1], city.lat)) return fail(1);
+        if (!csv::parseNumber(cols[2], city.lon)) return fail(2);
+        if (!csv::parseNumber(cols[3], city.temp)) return fail(3);
+        city.condition = text(4);
+        if (!csv::parseNumber(cols[5], city.wind)) return fail(5);
+        if (!csv::parseNumber(cols[6], city.humidity)) return fail(6);
+        if (!csv::parseNumber(cols[7], city.aqi)) return fail(7);
+        if (!csv::parseNumber(cols[8], city.rain)) return fail(8);
+        if (!csv::parseNumber(cols[9], city.windDir)) return fail(9);
+        return true;
+    }
+
+    struct ParsedChunk {
+        std::vector<City> cities;
+        std::vector<CsvRowError> errors;
+        size_t lines = 0;
+    };
+
+    static void parseCsvChunk(const char* begin, const char* end, ParsedChunk& chunk) {
+        const char* at = begin;
+        while (at < end) {
+            const char* newline = static_cast<const char*>(std::memchr(at, '\n', static_cast<size_t>(end - at)));
+            const char* lineEnd = newline ? newline : end;
+            std::string_view line(at, static_cast<size_t>(lineEnd - at));
+            if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            chunk.lines++;
+            at = newline ? newline + 1 : end;
+
+            if (csv::trim(line).empty()) continue;
+            City city;
+            std::string message;
+            if (!parseCityRow(line, city, message)) {
+                chunk.errors.push_back({chunk.lines, message});
+                continue;
+            }
+            chunk.cities.push_back(std::move(city));
         }
-        return data;
     }
 
-    static std::vector<int> buildWeeklySeries(int temp) {
-        return {temp - 2, temp, temp + 1, temp + 2, temp + 1, temp - 1, temp};
+    // The synthetic series are pure functions of the current temperature, so
+    // any slot can be produced on its own without building the whole vector.
+    static int seriesValue(SeriesKind kind, int temp, size_t slot) {
+        static const int weekly[] = {-2, 0, 1, 2, 1, -1, 0};
+        static const int yearly[] = {-13, -10, -5, 0, 5, 8, 7, 5, 2, -2, -7, -11};
+        switch (kind) {
+            case SeriesKind::Hourly: {
+                double wave = std::sin((static_cast<int>(slot) - 6) * 3.14159265 / 12.0);
+                return temp + static_cast<int>(std::round(wave * 4));
+            }
+            case SeriesKind::Weekly: return temp + weekly[slot];
+            case SeriesKind::Monthly: return temp + static_cast<int>(slot % 9) - 4;
+            default: return temp + yearly[slot];
+        }
     }
 
-    static std::vector<int> buildMonthlySeries(int temp) {
-        std::vector<int> data;
-        for (int day = 0; day < 30; day++) {
-            data.push_back(temp + static_cast<int>((day % 9) - 4));
+    static std::vector<int> buildSeries(SeriesKind kind, int temp) {
+        std::vector<int> data(SeriesStore::slotCount(kind));
+        for (size_t slot = 0; slot < data.size(); slot++) {
+            data[slot] = seriesValue(kind, temp, slot);
         }
         return data;
     }
 
-    static std::vector<int> buildYearlySeries(int temp) {
-        return {temp - 13, temp - 10, temp - 5, temp, temp + 5, temp + 8,
-                temp + 7, temp + 5, temp + 2, temp - 2, temp - 7, temp - 11};
+    static int forecastDrift(size_t day) {
+        return static_cast<int>(day % 5) - 2;
+    }
+
+    static int forecastRainProbability(double rain, size_t day) {
+        return rain > 0 ? std::min(95, 55 + static_cast<int>(rain * 5)) : 10 + static_cast<int>((day * 7) % 25);
     }
 
     static std::vector<DailyForecast> buildForecast(int temp, const std::string& condition, double rain) {
         const std::vector<std::string> days = {"Mon", "Tue", "Wed", "Thu", "Fri", "Sat", "Sun", "Mon", "Tue", "Wed"};
         std::vector<DailyForecast> forecast;
         for (size_t i = 0; i < days.size(); i++) {
-            int drift = static_cast<int>(i % 5) - 2;
-            int rainProbability = rain > 0 ? std::min(95, 55 + static_cast<int>(rain * 5)) : 10 + static_cast<int>((i * 7) % 25);
-            forecast.push_back({days[i], temp + drift + 3, temp + drift - 4, rainProbability, condition});
+            int drift = forecastDrift(i);
+            forecast.push_back({days[i], temp + drift + 3, temp + drift - 4, forecastRainProbability(rain, i), condition});
         }
         return forecast;
     }
 
+    // Extra risk a city adds to the routes through it on one forecast day.
+    static int forecastPenalty(int high, int low, int rainProbability) {
+        return rainProbability / 10 + (high >= 40 ? 3 : 0) + (low <= 0 ? 3 : 0);
+    }
+
     static double degToRad(double deg) {
         return deg * 3.14159265358979323846 / 180.0;
     }
@@ -192,7 +478,138 @@ private:
         node->terminal = true;
     }
 
+    // Every insert goes through here: a new key gets the next dense id, a
+    // replaced city keeps its id, and the series are mirrored into the store.
+    void storeCity(const std::string& key, City city) {
+        auto slot = cityDatabase.try_emplace(key);
+        city.id = slot.second ? cityDatabase.size() - 1 : slot.first->second.id;
+        if (!slot.second) derivedCache->erase(city.id);
+        std::vector<int>* explicitSeries[] = {&city.hourlyData, &city.weeklyData, &city.monthlyData, &city.yearlyData};
+        for (size_t k = 0; k < SeriesStore::kindCount; k++) {
+            SeriesKind kind = static_cast<SeriesKind>(k);
+            if (explicitSeries[k]->empty()) {
+                seriesStore.assignWith(city.id, kind, [&](size_t s) { return seriesValue(kind, city.temp, s); });
+            } else {
+                seriesStore.assign(city.id, kind, *explicitSeries[k]);
+            }
+        }
+        slot.first->second = std::move(city);
+        if (slot.second) citiesById.push_back(&slot.first->second);
+    }
+
+    // The adjacency list of a stored city, created on first use. Lists live in
+    // map nodes, so the pointer kept per city id stays valid.
+    std::vector<RouteEdge>& edgesOf(const std::string& key, size_t id) {
+        std::vector<RouteEdge>& edges = cityGraph[key];
+        if (edgesById.size() <= id) edgesById.resize(citiesById.size(), nullptr);
+        edgesById[id] = &edges;
+        return edges;
+    }
+
+    // The name and temperature orders, the forecast penalty table and the k-d
+    // trees are static; the loaders rebuild them once at the end and addCity()
+    // marks them stale for ensureIndexed(). Penalties come from the city's own
+    // forecast or, when it has none, from the same formula buildForecast()
+    // uses, without building it.
+    void reindexCities() const {
+        dayPenalty.assign(citiesById.size() * forecastDays, 0);
+        for (size_t id = 0; id < citiesById.size(); id++) {
+            const City& city = *citiesById[id];
+            for (size_t day = 0; day < forecastDays; day++) {
+                int penalty = 0;
+                if (day < city.tenDayForecast.size()) {
+                    const DailyForecast& f = city.tenDayForecast[day];
+                    penalty = forecastPenalty(f.high, f.low, f.rainProbability);
+                } else {
+                    int drift = forecastDrift(day);
+                    penalty = forecastPenalty(city.temp + drift + 3, city.temp + drift - 4, forecastRainProbability(city.rain, day));
+                }
+                dayPenalty[id * forecastDays + day] = penalty;
+            }
+        }
+
+
+        nameOrder = citiesById;
+        std::sort(nameOrder.begin(), nameOrder.end(), [](const City* a, const City* b) {
+            return a->name < b->name;
+        });
+        hottestOrder = nameOrder;
+        std::stable_sort(hottestOrder.begin(), hottestOrder.end(), [](const City* a, const City* b) {
+            return a->temp > b->temp;
+        });
+        coldestOrder = nameOrder;
+        std::stable_sort(coldestOrder.begin(), coldestOrder.end(), [](const City* a, const City* b) {
+            return a->temp < b->temp;
+        });
+
+        std::vector<double> lats(citiesById.size());
+        std::vector<double> lons(citiesById.size());
+        for (size_t i = 0; i < citiesById.size(); i++) {
+            lats[i] = citiesById[i]->lat;
+            lons[i] = citiesById[i]->lon;
+        }
+        spatialIndex.build(lats, lons);
+        indexStale.store(false, std::memory_order_release);
+    }
+
+    // Called by every reader of the orders, penalties or trees; after the
+    // first rebuild this is a single atomic load.
+    void ensureIndexed() const {
+        if (!indexStale.load(std::memory_order_acquire)) return;
+        std::lock_guard<std::mutex> lock(indexMutex);
+        if (indexStale.load(std::memory_order_relaxed)) reindexCities();
+    }
+
+    // remember = false reads the cache but does not insert, so bulk copies do
+    // not evict the entries single lookups are using.
+    std::shared_ptr<const DerivedSeries> derivedFor(const City& city, bool remember = true) const {
+        bool complete = !city.hourlyData.empty() && !city.weeklyData.empty() && !city.monthlyData.empty() &&
+                        !city.yearlyData.empty() && !city.tenDayForecast.empty();
+        if (complete) return nullptr;
+
+        auto make = [&] {
+            return DerivedSeries {buildSeries(SeriesKind::Hourly, city.temp), buildSeries(SeriesKind::Weekly, city.temp),
+                                  buildSeries(SeriesKind::Monthly, city.temp), buildSeries(SeriesKind::Yearly, city.temp),
+                                  buildForecast(city.temp, city.condition, city.rain)};
+        };
+        if (!remember) {
+            if (std::shared_ptr<const DerivedSeries> cached = derivedCache->find(city.id)) return cached;
+            return std::make_shared<const DerivedSeries>(make());
+        }
+
+        bool hit = false;
+        std::shared_ptr<const DerivedSeries> derived = derivedCache->findOrCreate(city.id, make, &hit);
+        Metrics::count(hit ? EngineCounter::CacheHits : EngineCounter::CacheMisses);
+        return derived;
+    }
+
+    // Fills whichever series the stored city left empty. Replacing a city
+    // drops its cached entry; nothing else invalidates one.
+    void fillDerived(City& city, bool remember = true) const {
+        std::shared_ptr<const DerivedSeries> derived = derivedFor(city, remember);
+        if (!derived) return;
+        if (city.hourlyData.empty()) city.hourlyData = derived->hourly;
+        if (city.weeklyData.empty()) city.weeklyData = derived->weekly;
+        if (city.monthlyData.empty()) city.monthlyData = derived->monthly;
+        if (city.yearlyData.empty()) city.yearlyData = derived->yearly;
+        if (city.tenDayForecast.empty()) city.tenDayForecast = derived->forecast;
+    }
+
 public:
+    static constexpr size_t forecastDays = 10;
+    static constexpr double travelKmPerDay = 600.0;
+
+    static std::string trim(std::string_view value) {
+        return std::string(csv::trim(value));
+    }
+
+    // The lookup key for a city name: trimmed and lower-cased.
+    static std::string normalize(std::string_view value) {
+        std::string out;
+        normalizeInto(value, out);
+        return out;
+    }
+
     bool loadCitiesFromCsv(const std::string& path, std::string* error = nullptr) {
         std::ifstream file(path);
         if (!file.is_open()) {
@@ -220,14 +637,11 @@ public:
             city.aqi = std::stoi(cols[7]);
             city.rain = std::stod(cols[8]);
             city.windDir = std::stoi(cols[9]);
-            city.hourlyData = buildHourlySeries(city.temp);
-            city.weeklyData = buildWeeklySeries(city.temp);
-            city.monthlyData = buildMonthlySeries(city.temp);
-            city.yearlyData = buildYearlySeries(city.temp);
-            city.tenDayForecast = buildForecast(city.temp, city.condition, city.rain);
-            addCity(city);
+            storeCity(normalize(city.name), city);
+            insertIntoTrie(city.name);
             loaded++;
         }
+        reindexCities();
 
         if (loaded == 0 && error) {
             *error = "No city rows were loaded from " + path;
@@ -235,26 +649,127 @@ public:
         return loaded > 0;
     }
 
+    // Maps the file, parses newline-aligned chunks on worker threads and merges
+    // the results in one pass. Bad rows are reported in report.errors (with
+    // 1-based file line numbers) instead of aborting the load.
+    bool loadCitiesFromCsvMapped(const std::string& path,
+                                 CsvLoadReport& report,
+                                 unsigned threads = 0,
+                                 std::string* error = nullptr) {
+        MappedFile file;
+        if (!file.open(path, error)) return false;
+
+        const char* begin = file.data();
+        const char* end = begin + file.size();
+        const char* header = begin ? static_cast<const char*>(std::memchr(begin, '\n', file.size())) : nullptr;
+        const char* body = header ? header + 1 : end;
+
+        constexpr size_t minChunkBytes = 1 << 16;
+        const size_t bodyBytes = static_cast<size_t>(end - body);
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        size_t chunkCount = std::max<size_t>(1, std::min<size_t>(threads, bodyBytes / minChunkBytes));
+
+        std::vector<const char*> bounds = {body};
+        for (size_t i = 1; i < chunkCount; i++) {
+            const char* at = std::max(bounds.back(), body + bodyBytes * i / chunkCount);
+            const char* newline = static_cast<const char*>(std::memchr(at, '\n', static_cast<size_t>(end - at)));
+            bounds.push_back(newline ? newline + 1 : end);
+        }
+        bounds.push_back(end);
+
+        std::vector<ParsedChunk> chunks(chunkCount);
+        std::vector<std::thread> workers;
+        for (size_t i = 1; i < chunkCount; i++) {
+            workers.emplace_back(parseCsvChunk, bounds[i], bounds[i + 1], std::ref(chunks[i]));
+        }
+        parseCsvChunk(bounds[0], bounds[1], chunks[0]);
+        for (std::thread& worker : workers) worker.join();
+
+        size_t total = 0;
+        for (const ParsedChunk& chunk : chunks) total += chunk.cities.size();
+        cityDatabase.reserve(cityDatabase.size() + total);
+        seriesStore.reserve(cityDatabase.size() + total);
+
+        size_t firstLine = 2;
+        for (ParsedChunk& chunk : chunks) {
+            for (City& city : chunk.cities) {
+                std::string displayName = city.name;
+                storeCity(normalize(displayName), std::move(city));
+                insertIntoTrie(displayName);
+            }
+            for (CsvRowError& rowError : chunk.errors) {
+                rowError.line += firstLine - 1;
+                report.errors.push_back(std::move(rowError));
+            }
+            firstLine += chunk.lines;
+        }
+        report.rowsLoaded += total;
+        reindexCities();
+
+        if (total == 0 && error) {
+            *error = "No city rows were loaded from " + path;
+        }
+        return total > 0;
+    }
+
+    // Bounds how many cities keep their derived series in memory; 0 derives
+    // them on every access. Resets the cache, so call it before serving.
+    void setDerivedCacheCapacity(size_t capacity) {
+        derivedCache = std::make_unique<LruCache<size_t, DerivedSeries>>(capacity);
+    }
+
+    size_t derivedCacheSize() const {
+        return derivedCache->size();
+    }
+
+    // The city orders and spatial index are rebuilt on the next query that
+    // reads them, so a run of inserts pays for one rebuild.
     void addCity(const City& city) {
-        cityDatabase[normalize(city.name)] = city;
+        storeCity(normalize(city.name), city);
         insertIntoTrie(city.name);
+        indexStale.store(true, std::memory_order_release);
     }
 
-    bool getCity(const std::string& name, City& out) const {
-        auto it = cityDatabase.find(normalize(name));
+    bool hasCity(std::string_view name) const {
+        return cityDatabase.count(lookupKey(name)) > 0;
+    }
+
+    bool getCity(std::string_view name, City& out) const {
+        auto it = cityDatabase.find(lookupKey(name));
         if (it == cityDatabase.end()) return false;
         out = it->second;
+        fillDerived(out);
         return true;
     }
 
+    // Zero-copy lookup: the stored record, or nullptr. Its series and forecast
+    // are empty when they are derived; use viewCity() to read those.
+    const City* findCity(std::string_view name) const {
+        auto it = cityDatabase.find(lookupKey(name));
+        return it == cityDatabase.end() ? nullptr : &it->second;
+    }
+
+    CityView viewCity(std::string_view name) const {
+        const City* city = findCity(name);
+        if (!city) return {};
+        return CityView(city, derivedFor(*city));
+    }
+
+    // Every city in name order, maintained at load time.
+    const std::vector<const City*>& citiesByName() const {
+        ensureIndexed();
+        return nameOrder;
+    }
+
+    // Full copies, like getCity(); citiesByName() is the zero-copy form.
     std::vector<City> getAllCities() const {
+        ensureIndexed();
         std::vector<City> cities;
-        for (const auto& pair : cityDatabase) {
-            cities.push_back(pair.second);
+        cities.reserve(nameOrder.size());
+        for (const City* city : nameOrder) {
+            cities.push_back(*city);
+            fillDerived(cities.back(), false);
         }
-        std::sort(cities.begin(), cities.end(), [](const City& a, const City& b) {
-            return a.name < b.name;
-        });
         return cities;
     }
 
@@ -265,8 +780,8 @@ public:
 
         double distance = haversineKm(a->second, b->second);
         int risk = riskScore(a->second, b->second);
-        cityGraph[normalize(cityA)].push_back({b->second.name, distance, risk});
-        cityGraph[normalize(cityB)].push_back({a->second.name, distance, risk});
+        edgesOf(a->first, a->second.id).push_back({b->second.name, distance, risk, b->second.id});
+        edgesOf(b->first, b->second.id).push_back({a->second.name, distance, risk, a->second.id});
     }
 
     void addRoute(const std::string& cityA, const std::string& cityB, int weatherRisk, double distanceKm) {
@@ -274,17 +789,146 @@ public:
         auto b = cityDatabase.find(normalize(cityB));
         if (a == cityDatabase.end() || b == cityDatabase.end()) return;
 
-        cityGraph[normalize(cityA)].push_back({b->second.name, distanceKm, weatherRisk});
-        cityGraph[normalize(cityB)].push_back({a->second.name, distanceKm, weatherRisk});
+        edgesOf(a->first, a->second.id).push_back({b->second.name, distanceKm, weatherRisk, b->second.id});
+        edgesOf(b->first, b->second.id).push_back({a->second.name, distanceKm, weatherRisk, a->second.id});
+    }
+
+    // Bulk insert: every endpoint is resolved once, each adjacency list is
+    // reserved to its final degree, and only then are the edges written.
+    // Indexes of routes naming an unknown city are appended to rejected.
+    size_t addRoutes(const std::vector<RouteSpec>& routes, std::vector<size_t>* rejected = nullptr) {
+        struct Resolved {
+            const City* from;
+            const City* to;
+            std::vector<RouteEdge>* fromEdges;
+            std::vector<RouteEdge>* toEdges;
+        };
+        std::vector<Resolved> resolved(routes.size(), {nullptr, nullptr, nullptr, nullptr});
+        std::vector<const std::string*> fromKeys(routes.size(), nullptr);
+        std::vector<const std::string*> toKeys(routes.size(), nullptr);
+        struct Adjacency {
+            size_t degree = 0;
+            size_t id = 0;
+            std::vector<RouteEdge>* edges = nullptr;
+        };
+        std::unordered_map<const std::string*, Adjacency> adjacency;
+        adjacency.reserve(std::min(cityDatabase.size(), routes.size() * 2));
+
+        for (size_t i = 0; i < routes.size(); i++) {
+            auto a = cityDatabase.find(normalize(routes[i].from));
+            auto b = cityDatabase.find(normalize(routes[i].to));
+            if (a == cityDatabase.end() || b == cityDatabase.end()) {
+                if (rejected) rejected->push_back(i);
+                continue;
+            }
+            resolved[i].from = &a->second;
+            resolved[i].to = &b->second;
+            fromKeys[i] = &a->first;
+            toKeys[i] = &b->first;
+            Adjacency& fromAdjacency = adjacency[&a->first];
+            fromAdjacency.degree++;
+            fromAdjacency.id = a->second.id;
+            Adjacency& toAdjacency = adjacency[&b->first];
+            toAdjacency.degree++;
+            toAdjacency.id = b->second.id;
+        }
+
+        // Each adjacency list grows once to its final size; the per-edge pass
+        // below then writes through cached pointers without hashing a name.
+        cityGraph.reserve(cityGraph.size() + adjacency.size());
+        for (auto& entry : adjacency) {
+            std::vector<RouteEdge>& edges = edgesOf(*entry.first, entry.second.id);
+            edges.reserve(edges.size() + entry.second.degree);
+            entry.second.edges = &edges;
+        }
+        for (size_t i = 0; i < routes.size(); i++) {
+            if (!resolved[i].from) continue;
+            resolved[i].fromEdges = adjacency.find(fromKeys[i])->second.edges;
+            resolved[i].toEdges = adjacency.find(toKeys[i])->second.edges;
+        }
+
+        size_t added = 0;
+        for (size_t i = 0; i < routes.size(); i++) {
+            const Resolved& r = resolved[i];
+            if (!r.from) continue;
+            double distance = routes[i].distanceKm >= 0 ? routes[i].distanceKm : haversineKm(*r.from, *r.to);
+            int risk = routes[i].weatherRisk >= 0 ? routes[i].weatherRisk : riskScore(*r.from, *r.to);
+            r.fromEdges->push_back({r.to->name, distance, risk, r.to->id});
+            r.toEdges->push_back({r.from->name, distance, risk, r.from->id});
+            added++;
+        }
+        return added;
     }
 
-    std::vector<RouteEdge> getNeighbors(const std::string& name) const {
-        auto it = cityGraph.find(normalize(name));
+    // Route network file: From,To[,Risk[,DistanceKm]] with a header row. Empty
+    // Risk/DistanceKm cells are derived from the cities. Bad rows and unknown
+    // cities are reported per line; the remaining edges are still loaded.
+    bool loadRoutesFromCsv(const std::string& path, CsvLoadReport& report, std::string* error = nullptr) {
+        MappedFile file;
+        if (!file.open(path, error)) return false;
+
+        const size_t firstError = report.errors.size();
+        std::vector<RouteSpec> routes;
+        std::vector<size_t> lines;
+        routes.reserve(file.size() / 24);
+        lines.reserve(file.size() / 24);
+
+        const char* at = file.data();
+        const char* end = at + file.size();
+        size_t lineNumber = 0;
+        while (at < end) {
+            const char* newline = static_cast<const char*>(std::memchr(at, '\n', static_cast<size_t>(end - at)));
+            std::string_view line(at, static_cast<size_t>((newline ? newline : end) - at));
+            if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            at = newline ? newline + 1 : end;
+            if (++lineNumber == 1 || csv::trim(line).empty()) continue;
+
+            std::string_view cols[4];
+            bool quoted[4];
+            size_t count = csv::splitFields(line, cols, quoted, 4);
+            RouteSpec route;
+            route.from = csv::fieldText(cols[0], quoted[0]);
+            route.to = count > 1 ? csv::fieldText(cols[1], quoted[1]) : "";
+            if (route.from.empty() || route.to.empty()) {
+                report.errors.push_back({lineNumber, "expected From and To columns"});
+                continue;
+            }
+            if (count > 2 && !cols[2].empty() && !csv::parseNumber(cols[2], route.weatherRisk)) {
+                report.errors.push_back({lineNumber, "invalid Risk value '" + std::string(cols[2]) + "'"});
+                continue;
+            }
+            if (count > 3 && !cols[3].empty() && !csv::parseNumber(cols[3], route.distanceKm)) {
+                report.errors.push_back({lineNumber, "invalid DistanceKm value '" + std::string(cols[3]) + "'"});
+                continue;
+            }
+            routes.push_back(std::move(route));
+            lines.push_back(lineNumber);
+        }
+
+        std::vector<size_t> rejected;
+        report.rowsLoaded += addRoutes(routes, &rejected);
+        for (size_t index : rejected) {
+            report.errors.push_back({lines[index], "unknown city in route " + routes[index].from + " - " + routes[index].to});
+        }
+        std::sort(report.errors.begin() + firstError, report.errors.end(), [](const CsvRowError& a, const CsvRowError& b) {
+            return a.line < b.line;
+        });
+        return true;
+    }
+
+    const std::vector<RouteEdge>& neighborsOf(std::string_view name) const {
+        static const std::vector<RouteEdge> none;
+        auto it = cityGraph.find(lookupKey(name));
+        return it == cityGraph.end() ? none : it->second;
+    }
+
+    std::vector<RouteEdge> getNeighbors(std::string_view name) const {
+        auto it = cityGraph.find(lookupKey(name));
         if (it == cityGraph.end()) return {};
         return it->second;
     }
 
-    std::vector<std::string> shortestRouteBfs(const std::string& start, const std::string& goal) const {
+    std::vector<std::string> shortestRouteBfs(std::string_view start, std::string_view goal) const {
         const std::string startKey = normalize(start);
         const std::string goalKey = normalize(goal);
         if (!cityDatabase.count(startKey) || !cityDatabase.count(goalKey)) return {};
@@ -356,7 +1000,7 @@ public:
         return result;
     }
 
-    RouteResult safestRouteDijkstra(const std::string& start, const std::string& goal) const {
+    RouteResult safestRouteDijkstra(std::string_view start, std::string_view goal) const {
         const std::string startKey = normalize(start);
         const std::string goalKey = normalize(goal);
         RouteResult result;
@@ -375,6 +1019,7 @@ public:
         risk[startKey] = 0;
         distance[startKey] = 0.0;
         pending.push({0, startKey});
+        uint64_t expanded = 0;
 
         while (!pending.empty()) {
             QueueItem item = pending.top();
@@ -382,6 +1027,7 @@ public:
             std::string current = item.second;
             pending.pop();
             if (currentRisk != risk[current]) continue;
+            expanded++;
             if (current == goalKey) break;
 
             auto graphIt = cityGraph.find(current);
@@ -398,6 +1044,7 @@ public:
                 }
             }
         }
+        Metrics::count(EngineCounter::DijkstraNodesExpanded, expanded);
 
         if (risk[goalKey] == std::numeric_limits<int>::max()) return result;
 
@@ -412,6 +1059,105 @@ public:
         return result;
     }
 
+    // Lowest-risk route when leaving on forecast day departDay (0 = today).
+    // An edge entered on day d costs its base risk plus the mean forecast
+    // penalty of its two endpoints on d; the day advances by travelKmPerDay
+    // of distance and stops at the last forecast day. The search runs over
+    // (city, day) states, so a costlier arrival that lands on a drier day is
+    // kept alongside the cheapest one: up to forecastDays states per city.
+    // Within one state the lowest-risk arrival wins, even if a longer one
+    // would reach the next day sooner. arrivalDay is the forecast day of the
+    // final state, so it never exceeds forecastDays - 1.
+    RouteResult safestRouteOnDay(std::string_view start, std::string_view goal, int departDay) const {
+        RouteResult result;
+        result.departDay = departDay;
+        const City* origin = findCity(start);
+        const City* target = findCity(goal);
+        if (!origin || !target || departDay < 0 || static_cast<size_t>(departDay) >= forecastDays) return result;
+        ensureIndexed();
+
+        SearchWorkspace& w = searchWorkspace();
+        w.begin(citiesById.size() * forecastDays);
+        const size_t originState = origin->id * forecastDays + static_cast<size_t>(departDay);
+        w.push(originState, 0, 0.0, originState, 0, 0.0);
+        uint64_t expanded = 0;
+
+        size_t state = 0;
+        bool reached = false;
+        while (w.pop(state, false)) {
+            expanded++;
+            const size_t id = state / forecastDays;
+            const size_t day = state % forecastDays;
+            if (id == target->id) {
+                reached = true;
+                break;
+            }
+            if (id >= edgesById.size() || !edgesById[id]) continue;
+            const int* here = &dayPenalty[id * forecastDays];
+            for (const RouteEdge& edge : *edgesById[id]) {
+                int edgeRisk = std::max(1, edge.weatherRisk + (here[day] + dayPenalty[edge.cityId * forecastDays + day]) / 2);
+                int risk = w.risk[state] + edgeRisk;
+                double km = w.distance[state] + edge.distanceKm;
+                size_t nextDay = std::min(forecastDays - 1, static_cast<size_t>(departDay) + static_cast<size_t>(km / travelKmPerDay));
+                size_t next = edge.cityId * forecastDays + nextDay;
+                if (w.seen(next) && risk >= w.risk[next]) continue;
+                w.push(next, risk, km, state, w.hops[state] + 1, static_cast<double>(risk));
+            }
+        }
+        Metrics::count(EngineCounter::DijkstraNodesExpanded, expanded);
+        if (!reached) return result;
+
+        result.found = true;
+        result.totalRisk = w.risk[state];
+        result.totalDistanceKm = w.distance[state];
+        result.arrivalDay = static_cast<int>(state % forecastDays);
+        for (size_t at = state;; at = w.parent[at]) {
+            result.path.push_back(citiesById[at / forecastDays]->name);
+            if (at == originState) break;
+        }
+        std::reverse(result.path.begin(), result.path.end());
+        return result;
+    }
+
+    // Every city reachable from start whose cheapest path stays within both
+    // budgets, in the order the search settles them (origin first). Paths
+    // are cheapest by risk, or by distance when byDistance is set; the other
+    // budget is checked along that path, and a city over it is not expanded.
+    // Returns false when start is unknown.
+    bool reachableCities(std::string_view start, int maxRisk, double maxKm,
+                         std::vector<ReachableCity>& out, bool byDistance = false) const {
+        out.clear();
+        const City* origin = findCity(start);
+        if (!origin) return false;
+
+        SearchWorkspace& w = searchWorkspace();
+        w.begin(citiesById.size());
+        w.push(origin->id, 0, 0.0, origin->id, 0, 0.0);
+        uint64_t expanded = 0;
+
+        size_t id = 0;
+        while (w.pop(id, byDistance)) {
+            expanded++;
+
+            const City* city = citiesById[id];
+            out.push_back({city, id == origin->id ? nullptr : citiesById[w.parent[id]], w.risk[id], w.distance[id], w.hops[id]});
+
+            if (id >= edgesById.size() || !edgesById[id]) continue;
+            for (const RouteEdge& edge : *edgesById[id]) {
+                int risk = w.risk[id] + edge.weatherRisk;
+                double distance = w.distance[id] + edge.distanceKm;
+                if (risk > maxRisk || distance > maxKm) continue;
+                if (w.seen(edge.cityId) &&
+                    (byDistance ? distance >= w.distance[edge.cityId] : risk >= w.risk[edge.cityId])) {
+                    continue;
+                }
+                w.push(edge.cityId, risk, distance, id, w.hops[id] + 1, byDistance ? distance : static_cast<double>(risk));
+            }
+        }
+        Metrics::count(EngineCounter::DijkstraNodesExpanded, expanded);
+        return true;
+    }
+
     void addAlert(int severity, const std::string& message, const std::string& city) {
         alertSystem.push({severity, message, city});
     }
@@ -426,36 +1172,107 @@ public:
         return alerts;
     }
 
+    // Ties keep name order. Both orders are kept at load time, so these cost
+    // O(k) instead of a sort per call.
+    std::vector<const City*> hottestCities(size_t k) const {
+        ensureIndexed();
+        k = std::min(k, hottestOrder.size());
+        return std::vector<const City*>(hottestOrder.begin(), hottestOrder.begin() + static_cast<std::ptrdiff_t>(k));
+    }
+
+    std::vector<const City*> coldestCities(size_t k) const {
+        ensureIndexed();
+        k = std::min(k, coldestOrder.size());
+        return std::vector<const City*>(coldestOrder.begin(), coldestOrder.begin() + static_cast<std::ptrdiff_t>(k));
+    }
+
+    // The same lists allocated from memory, typically a request arena.
+    std::pmr::vector<const City*> hottestCities(size_t k, std::pmr::memory_resource* memory) const {
+        ensureIndexed();
+        k = std::min(k, hottestOrder.size());
+        return std::pmr::vector<const City*>(hottestOrder.begin(), hottestOrder.begin() + static_cast<std::ptrdiff_t>(k),
+                                             memory);
+    }
+
+    std::pmr::vector<const City*> coldestCities(size_t k, std::pmr::memory_resource* memory) const {
+        ensureIndexed();
+        k = std::min(k, coldestOrder.size());
+        return std::pmr::vector<const City*>(coldestOrder.begin(), coldestOrder.begin() + static_cast<std::ptrdiff_t>(k),
+                                             memory);
+    }
+
     std::vector<City> getHottestCities(int k) const {
-        std::vector<City> cities = getAllCities();
-        if (k < 0) k = 0;
-        if (static_cast<size_t>(k) > cities.size()) k = static_cast<int>(cities.size());
-        std::partial_sort(cities.begin(), cities.begin() + k, cities.end(), [](const City& a, const City& b) {
-            return a.temp > b.temp;
-        });
-        cities.resize(k);
+        std::vector<City> cities;
+        for (const City* city : hottestCities(static_cast<size_t>(std::max(0, k)))) {
+            cities.push_back(*city);
+            fillDerived(cities.back());
+        }
         return cities;
     }
 
     std::vector<City> getColdestCities(int k) const {
-        std::vector<City> cities = getAllCities();
-        if (k < 0) k = 0;
-        if (static_cast<size_t>(k) > cities.size()) k = static_cast<int>(cities.size());
-        std::partial_sort(cities.begin(), cities.begin() + k, cities.end(), [](const City& a, const City& b) {
-            return a.temp < b.temp;
+        std::vector<City> cities;
+        for (const City* city : coldestCities(static_cast<size_t>(std::max(0, k)))) {
+            cities.push_back(*city);
+            fillDerived(cities.back());
+        }
+        return cities;
+    }
+
+    // The k cities closest to (lat, lon) by great-circle distance, nearest first.
+    std::vector<NearbyCity> nearestCities(double lat, double lon, size_t k) const {
+        ensureIndexed();
+        std::vector<NearbyCity> out;
+        for (const SpatialIndex::Neighbor& neighbor : spatialIndex.nearest(lat, lon, k)) {
+            out.push_back({citiesById[neighbor.id], neighbor.distanceKm});
+        }
+        return out;
+    }
+
+    // Cities inside a lat/lon box (minLon > maxLon wraps the antimeridian),
+    // sorted by name and capped at limit. total receives the uncapped count.
+    std::vector<const City*> citiesInBox(double minLat, double maxLat, double minLon, double maxLon,
+                                         size_t limit, size_t* total = nullptr) const {
+        ensureIndexed();
+        std::vector<uint32_t> ids;
+        spatialIndex.withinBox(minLat, maxLat, minLon, maxLon, ids);
+        if (total) *total = ids.size();
+        const size_t count = std::min(limit, ids.size());
+        std::partial_sort(ids.begin(), ids.begin() + static_cast<std::ptrdiff_t>(count), ids.end(), [&](uint32_t a, uint32_t b) {
+            return citiesById[a]->name < citiesById[b]->name;
         });
-        cities.resize(k);
+        std::vector<const City*> cities(count);
+        for (size_t i = 0; i < count; i++) cities[i] = citiesById[ids[i]];
         return cities;
     }
 
-    std::vector<std::string> autocomplete(const std::string& prefix, size_t limit = 5) const {
+    // Cross-city aggregate over one series kind; see SeriesStore::stats.
+    SeriesStats seriesStats(SeriesKind kind,
+                            size_t fromSlot,
+                            size_t toSlot,
+                            size_t window = 1,
+                            const std::vector<double>& percentiles = {50, 90, 99}) const {
+        return seriesStore.stats(kind, fromSlot, toSlot, window, percentiles);
+    }
+
+    const SeriesStore& series() const {
+        return seriesStore;
+    }
+
+    std::vector<std::string> autocomplete(std::string_view prefix, size_t limit = 5) const {
         const std::string key = normalize(prefix);
         const TrieNode* node = trieRoot.get();
+        uint64_t visited = 1;
         for (char ch : key) {
             auto it = node->children.find(ch);
-            if (it == node->children.end()) return {};
+            if (it == node->children.end()) {
+                Metrics::count(EngineCounter::TrieNodesVisited, visited);
+                return {};
+            }
             node = it->second.get();
+            visited++;
         }
+        Metrics::count(EngineCounter::TrieNodesVisited, visited);
 
         std::vector<std::string> matches = node->names;
         std::sort(matches.begin(), matches.end());
@@ -1,36 +1,185 @@
+#include "AdmissionControl.hpp"
+#include "EngineSnapshot.hpp"
+#include "Metrics.hpp"
 #include "NetworkUtils.hpp"
+#include "ObservationStore.hpp"
+#include "ReactorServer.hpp"
+#include "RequestArena.hpp"
+#include "SingleFlight.hpp"
+#include "SnapshotCell.hpp"
 #include "WeatherEngine.hpp"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
 #include <chrono>
+#include <cmath>
+#include <condition_variable>
 #include <csignal>
+#include <cstdio>
 #include <cstdlib>
+#include <deque>
+#include <filesystem>
 #include <iostream>
+#include <limits>
+#include <memory_resource>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
 #include <vector>
 
 namespace {
-WeatherEngine engine;
-bool running = true;
+SnapshotCell<WeatherEngine> engines;
+std::atomic<bool> running {true};
 
-std::string jsonEscape(const std::string& value) {
-    std::ostringstream out;
-    for (char ch : value) {
-        switch (ch) {
-            case '"': out << "\\\""; break;
-            case '\\': out << "\\\\"; break;
-            case '\n': out << "\\n"; break;
-            case '\r': out << "\\r"; break;
-            case '\t': out << "\\t"; break;
-            default: out << ch; break;
+// Metric labels for every path the server answers; the last entry catches
+// everything else so unknown URLs cannot grow the label set.
+const std::vector<std::string> routeNames = {
+    "/api/cities", "/api/weather", "/api/suggest", "/api/hottest", "/api/coldest",
+    "/api/alerts", "/api/route", "/api/reachable", "/api/stats", "/api/observations", "/api/nearest", "/api/bbox", "/api/requests", "/api/metrics", "/api/reload", "/", "other"
+};
+
+size_t routeIndex(const std::string& path) {
+    const std::string& key = path == "/data" ? routeNames[1] : path == "/index.html" ? "/" : path;
+    for (size_t i = 0; i + 1 < routeNames.size(); i++) {
+        if (routeNames[i] == key) return i;
+    }
+    return routeNames.size() - 1;
+}
+
+// Requests only ever write to the log, so it lives outside the immutable
+// engine snapshots and survives reloads. Writers pick a shard by thread, so
+// reactors rarely meet on a lock; a global sequence number lets recent()
+// merge the shards back into arrival order.
+class RequestLog {
+public:
+    void push(const std::string& method, const std::string& url) {
+        uint64_t sequence = nextSequence.fetch_add(1, std::memory_order_relaxed);
+        std::string request;
+        request.reserve(method.size() + 1 + url.size());
+        request += method;
+        request += ' ';
+        request += url;
+        Shard& shard = shards[std::hash<std::thread::id> {}(std::this_thread::get_id()) % shards.size()];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.entries.push_back({sequence, std::move(request)});
+        if (shard.entries.size() > 50) shard.entries.pop_front();
+    }
+
+    std::vector<std::string> recent(size_t limit) const {
+        std::vector<std::pair<uint64_t, std::string>> merged;
+        for (const Shard& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            size_t take = std::min(limit, shard.entries.size());
+            merged.insert(merged.end(), shard.entries.end() - static_cast<std::ptrdiff_t>(take), shard.entries.end());
         }
+        std::sort(merged.begin(), merged.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+        std::vector<std::string> out;
+        for (size_t i = 0; i < merged.size() && out.size() < limit; i++) out.push_back(std::move(merged[i].second));
+        return out;
     }
-    return out.str();
+
+private:
+    struct Shard {
+        mutable std::mutex mutex;
+        std::deque<std::pair<uint64_t, std::string>> entries;
+    };
+
+    std::atomic<uint64_t> nextSequence {0};
+    std::array<Shard, 16> shards;
+};
+
+RequestLog requestLog;
+ObservationStore observations;
+
+// The body is a heap string because a response can outlive its request: the
+// reactor caches and coalesced callers share it. Status text and content
+// type are always literals.
+struct ApiResponse {
+    std::string body;
+    int statusCode = 200;
+    const char* statusText = "OK";
+    const char* contentType = "application/json";
+    int retryAfterSeconds = 0;
+};
+
+// Marks text for escaping as a JSON string body when written to a JsonWriter.
+struct JsonEscaped {
+    std::string_view text;
+};
+
+JsonEscaped jsonEscape(std::string_view value) {
+    return {value};
 }
 
+// Builds JSON text in the calling thread's request arena. Streams like an
+// ostringstream and formats numbers the same way (doubles as %g), but
+// appending is a bump allocation and nothing is freed until the request
+// ends. Fragments returned by the helpers below are arena strings too.
+class JsonWriter {
+public:
+    JsonWriter() : out(RequestArena::local().resource()) {}
+
+    JsonWriter& operator<<(std::string_view text) {
+        out += text;
+        return *this;
+    }
+
+    JsonWriter& operator<<(const char* text) {
+        out += text;
+        return *this;
+    }
+
+    JsonWriter& operator<<(char ch) {
+        out += ch;
+        return *this;
+    }
+
+    JsonWriter& operator<<(double value) {
+        char buffer[32];
+        int length = std::snprintf(buffer, sizeof(buffer), "%g", value);
+        out.append(buffer, static_cast<size_t>(std::max(0, length)));
+        return *this;
+    }
+
+    template <typename T, typename = std::enable_if_t<std::is_integral_v<T>>>
+    JsonWriter& operator<<(T value) {
+        char buffer[24];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        out.append(buffer, static_cast<size_t>(result.ptr - buffer));
+        return *this;
+    }
+
+    JsonWriter& operator<<(JsonEscaped value) {
+        for (char ch : value.text) {
+            switch (ch) {
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                case '\r': out += "\\r"; break;
+                case '\t': out += "\\t"; break;
+                default: out += ch; break;
+            }
+        }
+        return *this;
+    }
+
+    std::pmr::string str() {
+        return std::move(out);
+    }
+
+private:
+    std::pmr::string out;
+};
+
 template <typename T>
-std::string numberArrayJson(const std::vector<T>& values) {
-    std::ostringstream json;
+std::pmr::string numberArrayJson(const std::vector<T>& values) {
+    JsonWriter json;
     json << "[";
     for (size_t i = 0; i < values.size(); i++) {
         json << values[i];
@@ -40,8 +189,24 @@ std::string numberArrayJson(const std::vector<T>& values) {
     return json.str();
 }
 
-std::string stringArrayJson(const std::vector<std::string>& values) {
-    std::ostringstream json;
+// Means of a rollup window; slots without observations are null.
+std::pmr::string rollupMeansJson(const std::vector<RollupBucket>& buckets) {
+    JsonWriter json;
+    json << "[";
+    for (size_t i = 0; i < buckets.size(); i++) {
+        if (buckets[i].count > 0) {
+            json << buckets[i].mean();
+        } else {
+            json << "null";
+        }
+        if (i + 1 < buckets.size()) json << ",";
+    }
+    json << "]";
+    return json.str();
+}
+
+std::pmr::string stringArrayJson(const std::vector<std::string>& values) {
+    JsonWriter json;
     json << "[";
     for (size_t i = 0; i < values.size(); i++) {
         json << "\"" << jsonEscape(values[i]) << "\"";
@@ -51,8 +216,8 @@ std::string stringArrayJson(const std::vector<std::string>& values) {
     return json.str();
 }
 
-std::string forecastJson(const std::vector<DailyForecast>& forecast) {
-    std::ostringstream json;
+std::pmr::string forecastJson(const std::vector<DailyForecast>& forecast) {
+    JsonWriter json;
     json << "[";
     for (size_t i = 0; i < forecast.size(); i++) {
         const DailyForecast& day = forecast[i];
@@ -69,8 +234,8 @@ std::string forecastJson(const std::vector<DailyForecast>& forecast) {
     return json.str();
 }
 
-std::string routeEdgesJson(const std::vector<RouteEdge>& edges) {
-    std::ostringstream json;
+std::pmr::string routeEdgesJson(const std::vector<RouteEdge>& edges) {
+    JsonWriter json;
     json << "[";
     for (size_t i = 0; i < edges.size(); i++) {
         json << "{"
@@ -84,15 +249,16 @@ std::string routeEdgesJson(const std::vector<RouteEdge>& edges) {
     return json.str();
 }
 
-std::string cityListJson(const std::vector<City>& cities, bool includeTemp = false) {
-    std::ostringstream json;
+template <typename Cities>
+std::pmr::string cityListJson(const Cities& cities, bool includeTemp = false) {
+    JsonWriter json;
     json << "[";
     for (size_t i = 0; i < cities.size(); i++) {
         json << "{"
-             << "\"name\":\"" << jsonEscape(cities[i].name) << "\"";
+             << "\"name\":\"" << jsonEscape(cities[i]->name) << "\"";
         if (includeTemp) {
-            json << ",\"temp\":" << cities[i].temp
-                 << ",\"condition\":\"" << jsonEscape(cities[i].condition) << "\"";
+            json << ",\"temp\":" << cities[i]->temp
+                 << ",\"condition\":\"" << jsonEscape(cities[i]->condition) << "\"";
         }
         json << "}";
         if (i + 1 < cities.size()) json << ",";
@@ -101,8 +267,15 @@ std::string cityListJson(const std::vector<City>& cities, bool includeTemp = fal
     return json.str();
 }
 
-std::string weatherJson(const City& city) {
-    std::ostringstream json;
+// observed, when set, carries rollups from the observation store that take
+// the place of the city's own series.
+std::pmr::string weatherJson(const CityView& view,
+                        const ObservedWindows* observed,
+                        const std::vector<RouteEdge>& neighbors,
+                        const std::pmr::vector<const City*>& hottest,
+                        const std::pmr::vector<const City*>& coldest) {
+    const City& city = view.city();
+    JsonWriter json;
     json << "{"
          << "\"city\":\"" << jsonEscape(city.name) << "\","
          << "\"lat\":" << city.lat << ","
@@ -116,22 +289,29 @@ std::string weatherJson(const City& city) {
          << "\"aqi\":" << city.aqi << ","
          << "\"wind_dir\":" << city.windDir << ","
          << "\"condition\":\"" << jsonEscape(city.condition) << "\""
-         << "},"
-         << "\"hourly\":" << numberArrayJson(city.hourlyData) << ","
-         << "\"weekly\":" << numberArrayJson(city.weeklyData) << ","
-         << "\"monthly\":" << numberArrayJson(city.monthlyData) << ","
-         << "\"yearly\":" << numberArrayJson(city.yearlyData) << ","
-         << "\"forecast\":" << forecastJson(city.tenDayForecast) << ","
-         << "\"neighbors\":" << routeEdgesJson(engine.getNeighbors(city.name)) << ","
-         << "\"hottest_cities\":" << cityListJson(engine.getHottestCities(5), true) << ","
-         << "\"coldest_cities\":" << cityListJson(engine.getColdestCities(5), true)
+         << "},";
+    if (observed) {
+        json << "\"observed_until\":" << observed->newestTime << ","
+             << "\"hourly\":" << rollupMeansJson(observed->hourly) << ","
+             << "\"weekly\":" << rollupMeansJson(observed->weekly) << ","
+             << "\"monthly\":" << rollupMeansJson(observed->monthly) << ","
+             << "\"yearly\":" << rollupMeansJson(observed->yearly) << ",";
+    } else {
+        json << "\"hourly\":" << numberArrayJson(view.series(SeriesKind::Hourly)) << ","
+             << "\"weekly\":" << numberArrayJson(view.series(SeriesKind::Weekly)) << ","
+             << "\"monthly\":" << numberArrayJson(view.series(SeriesKind::Monthly)) << ","
+             << "\"yearly\":" << numberArrayJson(view.series(SeriesKind::Yearly)) << ",";
+    }
+    json << "\"forecast\":" << forecastJson(view.forecast()) << ","
+         << "\"neighbors\":" << routeEdgesJson(neighbors) << ","
+         << "\"hottest_cities\":" << cityListJson(hottest, true) << ","
+         << "\"coldest_cities\":" << cityListJson(coldest, true)
          << "}";
     return json.str();
 }
 
-std::string alertsJson(int k) {
-    std::vector<Alert> alerts = engine.getTopAlerts(k);
-    std::ostringstream json;
+std::pmr::string alertsJson(const std::vector<Alert>& alerts) {
+    JsonWriter json;
     json << "[";
     for (size_t i = 0; i < alerts.size(); i++) {
         json << "{"
@@ -145,19 +325,122 @@ std::string alertsJson(int k) {
     return json.str();
 }
 
-std::string routeJson(const RouteResult& route, const std::string& algorithm) {
-    std::ostringstream json;
+std::pmr::string routeJson(const RouteResult& route, const std::string& algorithm) {
+    JsonWriter json;
     json << "{"
          << "\"found\":" << (route.found ? "true" : "false") << ","
          << "\"algorithm\":\"" << algorithm << "\","
          << "\"path\":" << stringArrayJson(route.path) << ","
          << "\"hops\":" << (route.path.empty() ? 0 : route.path.size() - 1) << ","
          << "\"total_risk\":" << route.totalRisk << ","
-         << "\"total_distance_km\":" << static_cast<int>(route.totalDistanceKm + 0.5)
+         << "\"total_distance_km\":" << static_cast<int>(route.totalDistanceKm + 0.5);
+    if (route.departDay >= 0) {
+        json << ",\"depart_day\":" << route.departDay;
+        if (route.found) json << ",\"arrival_day\":" << route.arrivalDay;
+    }
+    json << "}";
+    return json.str();
+}
+
+std::pmr::string statsJson(const SeriesStats& stats) {
+    JsonWriter json;
+    json << "{"
+         << "\"series\":\"" << SeriesStore::kindName(stats.kind) << "\","
+         << "\"cities\":" << stats.cities << ","
+         << "\"from\":" << stats.fromSlot << ","
+         << "\"to\":" << stats.toSlot << ","
+         << "\"window\":" << stats.window << ","
+         << "\"samples\":" << stats.samples << ","
+         << "\"min\":" << stats.min << ","
+         << "\"max\":" << stats.max << ","
+         << "\"mean\":" << stats.mean << ","
+         << "\"percentiles\":{";
+    for (size_t i = 0; i < stats.percentiles.size(); i++) {
+        json << "\"p" << stats.percentiles[i].first << "\":" << stats.percentiles[i].second;
+        if (i + 1 < stats.percentiles.size()) json << ",";
+    }
+    json << "},"
+         << "\"slot_means\":" << numberArrayJson(stats.slotMeans) << ","
+         << "\"isa\":\"" << SeriesKernels::isa() << "\""
          << "}";
     return json.str();
 }
 
+std::pmr::string observationsJson(const std::string& city, const std::vector<Observation>& points) {
+    JsonWriter json;
+    json << "{"
+         << "\"city\":\"" << jsonEscape(city) << "\","
+         << "\"count\":" << points.size() << ","
+         << "\"points\":[";
+    for (size_t i = 0; i < points.size(); i++) {
+        json << "[" << points[i].time << "," << points[i].temp << "]";
+        if (i + 1 < points.size()) json << ",";
+    }
+    json << "]}";
+    return json.str();
+}
+
+std::pmr::string placeJson(const City& city) {
+    JsonWriter json;
+    json << "\"name\":\"" << jsonEscape(city.name) << "\","
+         << "\"lat\":" << city.lat << ","
+         << "\"lon\":" << city.lon << ","
+         << "\"temp\":" << city.temp << ","
+         << "\"condition\":\"" << jsonEscape(city.condition) << "\"";
+    return json.str();
+}
+
+std::pmr::string nearestJson(const std::vector<NearbyCity>& cities) {
+    JsonWriter json;
+    json << "[";
+    for (size_t i = 0; i < cities.size(); i++) {
+        json << "{" << placeJson(*cities[i].city) << ","
+             << "\"distance_km\":" << std::round(cities[i].distanceKm * 10.0) / 10.0 << "}";
+        if (i + 1 < cities.size()) json << ",";
+    }
+    json << "]";
+    return json.str();
+}
+
+std::pmr::string bboxJson(const std::vector<const City*>& cities, size_t total) {
+    JsonWriter json;
+    json << "{\"total\":" << total << ",\"truncated\":" << (total > cities.size() ? "true" : "false") << ",\"cities\":[";
+    for (size_t i = 0; i < cities.size(); i++) {
+        json << "{" << placeJson(*cities[i]) << "}";
+        if (i + 1 < cities.size()) json << ",";
+    }
+    json << "]}";
+    return json.str();
+}
+
+std::pmr::string reachableJson(const std::string& from, bool byDistance,
+                          const std::vector<ReachableCity>& cities, size_t limit) {
+    const size_t count = std::min(limit, cities.size());
+    JsonWriter json;
+    json << "{\"from\":\"" << jsonEscape(from) << "\","
+         << "\"by\":\"" << (byDistance ? "km" : "risk") << "\","
+         << "\"total\":" << cities.size() << ","
+         << "\"truncated\":" << (count < cities.size() ? "true" : "false") << ","
+         << "\"cities\":[";
+    for (size_t i = 0; i < count; i++) {
+        const ReachableCity& reached = cities[i];
+        json << "{\"name\":\"" << jsonEscape(reached.city->name) << "\","
+             << "\"risk\":" << reached.risk << ","
+             << "\"distance_km\":" << std::round(reached.distanceKm * 10.0) / 10.0 << ","
+             << "\"hops\":" << reached.hops << ","
+             << "\"via\":";
+        if (reached.via) {
+            json << "\"" << jsonEscape(reached.via->name) << "\"";
+        } else {
+            json << "null";
+        }
+        json << "}";
+        if (i + 1 < count) json << ",";
+    }
+    json << "]}";
+    return json.str();
+}
+
 std::string findExistingPath(const std::vector<std::string>& candidates) {
     for (const std::string& path : candidates) {
         if (!SimpleServer::loadTextFile(path).empty()) return path;
@@ -165,42 +448,41 @@ std::string findExistingPath(const std::vector<std::string>& candidates) {
     return "";
 }
 
-int parseIntParam(const std::unordered_map<std::string, std::string>& params,
-                  const std::string& key,
+// Query values live in the request arena. The few places that need a
+// std::string (number parsing, mostly) copy them out, which for short
+// values stays within the small-string buffer.
+std::string_view paramOr(const QueryParams& params, const char* key, std::string_view fallback) {
+    auto it = params.find(key);
+    return it == params.end() ? fallback : std::string_view(it->second);
+}
+
+// Missing or malformed values (including trailing junk, as in "5abc") fall
+// back to the default. Parsed in place, without copying the value.
+int parseIntParam(const QueryParams& params,
+                  const char* key,
                   int fallback) {
     auto it = params.find(key);
-    if (it == params.end()) return fallback;
-    try {
-        return std::stoi(it->second);
-    } catch (...) {
-        return fallback;
-    }
-}
-
-void sendJson(SOCKET clientSock, const std::string& body, int statusCode = 200, const std::string& statusText = "OK") {
-    SimpleServer::sendResponse(clientSock, body, "application/json", statusCode, statusText);
-}
-
-void seedRoutesAndAlerts() {
-    engine.addRoute("Islamabad", "Peshawar");
-    engine.addRoute("Islamabad", "Lahore");
-    engine.addRoute("Islamabad", "Topi");
-    engine.addRoute("Islamabad", "Rawalpindi");
-    engine.addRoute("Peshawar", "Topi");
-    engine.addRoute("Rawalpindi", "Lahore");
-    engine.addRoute("Lahore", "Multan");
-    engine.addRoute("Lahore", "Faisalabad");
-    engine.addRoute("Faisalabad", "Multan");
-    engine.addRoute("Multan", "Hyderabad");
-    engine.addRoute("Hyderabad", "Karachi");
-    engine.addRoute("Karachi", "Quetta");
-    engine.addRoute("Quetta", "Multan");
-
-    // High-risk shortcut corridors make BFS and Dijkstra visibly different.
-    engine.addRoute("Lahore", "Karachi", 90, 1020);
-    engine.addRoute("Faisalabad", "Karachi", 75, 945);
-
-    for (const City& city : engine.getAllCities()) {
+    int value = 0;
+    if (it == params.end() || !csv::parseNumber(std::string_view(it->second), value)) return fallback;
+    return value;
+}
+
+bool parseDoubleParam(const QueryParams& params,
+                      const char* key,
+                      double& out) {
+    auto it = params.find(key);
+    return it != params.end() && csv::parseNumber(std::string_view(it->second), out) && std::isfinite(out);
+}
+
+ApiResponse jsonResponse(std::string_view body, int statusCode = 200, const char* statusText = "OK") {
+    return {std::string(body), statusCode, statusText, "application/json"};
+}
+
+// Alerts are derived from the loaded conditions; routes come from the route
+// network file.
+void seedAlerts(WeatherEngine& engine) {
+    for (const City* record : engine.citiesByName()) {
+        const City& city = *record;
         if (city.temp >= 30) {
             engine.addAlert(9, "Heat advisory: high temperature trend", city.name);
         }
@@ -216,77 +498,530 @@ void seedRoutesAndAlerts() {
     }
 }
 
-void handleApi(SOCKET clientSock, const std::string& path, const std::unordered_map<std::string, std::string>& params) {
+struct DataSource {
+    std::string citiesPath;
+    std::string routesPath;
+};
+
+void printRowErrors(const std::string& path, const CsvLoadReport& report) {
+    for (size_t i = 0; i < report.errors.size() && i < 20; i++) {
+        std::cerr << path << ":" << report.errors[i].line << ": " << report.errors[i].message << std::endl;
+    }
+    if (report.errors.size() > 20) {
+        std::cerr << "... " << report.errors.size() - 20 << " more rejected rows" << std::endl;
+    }
+}
+
+std::shared_ptr<WeatherEngine> buildFromCsv(const DataSource& source) {
+    auto engine = std::make_shared<WeatherEngine>();
+    std::string loadError;
+    CsvLoadReport cityReport;
+    bool loaded = engine->loadCitiesFromCsvMapped(source.citiesPath, cityReport, 0, &loadError);
+    printRowErrors(source.citiesPath, cityReport);
+    if (!loaded) {
+        std::cerr << loadError << std::endl;
+        return nullptr;
+    }
+
+    if (!source.routesPath.empty()) {
+        CsvLoadReport routeReport;
+        if (!engine->loadRoutesFromCsv(source.routesPath, routeReport, &loadError)) {
+            std::cerr << loadError << std::endl;
+            return nullptr;
+        }
+        printRowErrors(source.routesPath, routeReport);
+    }
+    seedAlerts(*engine);
+    return engine;
+}
+
+// Rebuilds the engine from the CSV files on a background thread whenever one
+// of them changes or a reload is requested, then publishes it. Requests keep using
+// whichever snapshot they pinned; a failed rebuild leaves the current one live.
+class Reloader {
+public:
+    Reloader(DataSource source, std::chrono::milliseconds pollInterval)
+        : source(std::move(source)), pollInterval(pollInterval), lastSeen(signature()) {}
+
+    ~Reloader() {
+        stop();
+    }
+
+    void start() {
+        worker = std::thread([this] { run(); });
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        if (worker.joinable()) worker.join();
+    }
+
+    void requestReload() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            requested = true;
+        }
+        wake.notify_all();
+    }
+
+private:
+    DataSource source;
+    std::chrono::milliseconds pollInterval;
+    std::string lastSeen;
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool requested = false;
+    bool stopping = false;
+
+    std::string signature() const {
+        std::string out;
+        for (const std::string& path : {source.citiesPath, source.routesPath}) {
+            if (path.empty()) continue;
+            std::error_code ec;
+            auto modified = std::filesystem::last_write_time(path, ec);
+            if (ec) return "";
+            auto size = std::filesystem::file_size(path, ec);
+            out += std::to_string(modified.time_since_epoch().count()) + ":" + std::to_string(ec ? 0 : size) + ";";
+        }
+        return out;
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!stopping) {
+            if (pollInterval.count() > 0) {
+                wake.wait_for(lock, pollInterval, [this] { return stopping || requested; });
+            } else {
+                wake.wait(lock, [this] { return stopping || requested; });
+            }
+            if (stopping) break;
+
+            bool forced = requested;
+            requested = false;
+            std::string current = signature();
+            if (!forced && (current.empty() || current == lastSeen)) continue;
+            lastSeen = current;
+
+            lock.unlock();
+            auto started = std::chrono::steady_clock::now();
+            std::shared_ptr<WeatherEngine> next = buildFromCsv(source);
+            if (next) {
+                size_t cityCount = next->citiesByName().size();
+                engines.publish(std::move(next));
+                std::cout << "Reloaded " << cityCount << " cities from " << source.citiesPath << " in "
+                          << std::chrono::duration_cast<std::chrono::milliseconds>(
+                                 std::chrono::steady_clock::now() - started).count()
+                          << " ms (generation " << engines.generation() << ")" << std::endl;
+            } else {
+                std::cerr << "Reload of " << source.citiesPath << " failed; still serving generation "
+                          << engines.generation() << std::endl;
+            }
+            lock.lock();
+        }
+    }
+};
+
+Reloader* reloader = nullptr;
+
+ApiResponse handleApi(const WeatherEngine& engine,
+                      const std::string& method,
+                      const std::string& path,
+                      const QueryParams& params,
+                      RequestTrace& trace) {
     if (path == "/api/cities") {
-        sendJson(clientSock, cityListJson(engine.getAllCities()));
-        return;
+        trace.mark(RequestStage::Route);
+        return jsonResponse(cityListJson(engine.citiesByName()));
     }
 
     if (path == "/api/weather" || path == "/data") {
-        std::string cityName = params.count("city") ? params.at("city") : "Topi";
-        City city;
-        if (!engine.getCity(cityName, city)) {
-            sendJson(clientSock, "{\"error\":\"City not found\"}", 404, "Not Found");
-            return;
+        std::string_view cityName = paramOr(params, "city", "Topi");
+        CityView view = engine.viewCity(cityName);
+        if (!view) {
+            return jsonResponse("{\"error\":\"City not found\"}", 404, "Not Found");
         }
-        sendJson(clientSock, weatherJson(city));
-        return;
+        ObservedWindows observed;
+        bool hasObserved = observations.windows(view.city().name, observed);
+        std::pmr::memory_resource* arena = RequestArena::local().resource();
+        std::pmr::vector<const City*> hottest = engine.hottestCities(5, arena);
+        std::pmr::vector<const City*> coldest = engine.coldestCities(5, arena);
+        trace.mark(RequestStage::Route);
+        return jsonResponse(weatherJson(view, hasObserved ? &observed : nullptr,
+                                        engine.neighborsOf(view.city().name), hottest, coldest));
     }
 
     if (path == "/api/suggest") {
-        std::string query = params.count("q") ? params.at("q") : "";
-        sendJson(clientSock, stringArrayJson(engine.autocomplete(query, 8)));
-        return;
+        std::string_view query = paramOr(params, "q", "");
+        std::vector<std::string> suggestions = engine.autocomplete(query, 8);
+        trace.mark(RequestStage::Route);
+        return jsonResponse(stringArrayJson(suggestions));
     }
 
     if (path == "/api/hottest") {
         int k = parseIntParam(params, "k", 5);
-        sendJson(clientSock, cityListJson(engine.getHottestCities(k), true));
-        return;
+        std::pmr::vector<const City*> cities =
+            engine.hottestCities(static_cast<size_t>(std::max(0, k)), RequestArena::local().resource());
+        trace.mark(RequestStage::Route);
+        return jsonResponse(cityListJson(cities, true));
     }
 
     if (path == "/api/coldest") {
         int k = parseIntParam(params, "k", 5);
-        sendJson(clientSock, cityListJson(engine.getColdestCities(k), true));
-        return;
+        std::pmr::vector<const City*> cities =
+            engine.coldestCities(static_cast<size_t>(std::max(0, k)), RequestArena::local().resource());
+        trace.mark(RequestStage::Route);
+        return jsonResponse(cityListJson(cities, true));
     }
 
     if (path == "/api/alerts") {
         int k = parseIntParam(params, "k", 5);
-        sendJson(clientSock, alertsJson(k));
-        return;
+        std::vector<Alert> alerts = engine.getTopAlerts(k);
+        trace.mark(RequestStage::Route);
+        return jsonResponse(alertsJson(alerts));
     }
 
     if (path == "/api/route") {
-        std::string from = params.count("from") ? params.at("from") : "";
-        std::string to = params.count("to") ? params.at("to") : "";
-        std::string mode = params.count("mode") ? params.at("mode") : "safe";
+        std::string_view from = paramOr(params, "from", "");
+        std::string_view to = paramOr(params, "to", "");
+        std::string_view mode = paramOr(params, "mode", "safe");
 
         if (from.empty() || to.empty()) {
-            sendJson(clientSock, "{\"error\":\"Route requires from and to query params\"}", 400, "Bad Request");
-            return;
+            return jsonResponse("{\"error\":\"Route requires from and to query params\"}", 400, "Bad Request");
         }
 
         if (mode == "bfs") {
             std::vector<std::string> path = engine.shortestRouteBfs(from, to);
             RouteResult result = engine.summarizePath(path);
-            sendJson(clientSock, routeJson(result, "BFS shortest hops"));
-            return;
+            trace.mark(RequestStage::Route);
+            return jsonResponse(routeJson(result, "BFS shortest hops"));
         }
 
-        sendJson(clientSock, routeJson(engine.safestRouteDijkstra(from, to), "Dijkstra lowest weather risk"));
-        return;
+        if (params.count("depart_day")) {
+            int departDay = parseIntParam(params, "depart_day", -1);
+            if (departDay < 0 || departDay >= static_cast<int>(WeatherEngine::forecastDays)) {
+                return jsonResponse("{\"error\":\"depart_day must be between 0 and " +
+                                    std::to_string(WeatherEngine::forecastDays - 1) + "\"}", 400, "Bad Request");
+            }
+            RouteResult result = engine.safestRouteOnDay(from, to, departDay);
+            trace.mark(RequestStage::Route);
+            return jsonResponse(routeJson(result, "Time-dependent Dijkstra lowest forecast risk"));
+        }
+
+        RouteResult result = engine.safestRouteDijkstra(from, to);
+        trace.mark(RequestStage::Route);
+        return jsonResponse(routeJson(result, "Dijkstra lowest weather risk"));
+    }
+
+    if (path == "/api/reachable") {
+        std::string_view from = paramOr(params, "from", "");
+        std::string_view by = paramOr(params, "by", "risk");
+        int maxRisk = std::numeric_limits<int>::max();
+        double maxKm = std::numeric_limits<double>::infinity();
+        bool bounded = params.count("max_risk") || params.count("max_km");
+        if (params.count("max_risk")) maxRisk = parseIntParam(params, "max_risk", -1);
+        if (params.count("max_km") && !parseDoubleParam(params, "max_km", maxKm)) maxKm = -1.0;
+        if (from.empty() || !bounded || maxRisk < 0 || maxKm < 0 || (by != "risk" && by != "km")) {
+            return jsonResponse("{\"error\":\"reachable requires from plus max_risk and/or max_km (>= 0); by is risk or km\"}",
+                                400, "Bad Request");
+        }
+        int limit = std::min(10000, std::max(1, parseIntParam(params, "limit", 1000)));
+
+        // Kept per thread so steady-state queries reuse its capacity.
+        static thread_local std::vector<ReachableCity> reached;
+        if (!engine.reachableCities(from, maxRisk, maxKm, reached, by == "km")) {
+            return jsonResponse("{\"error\":\"City not found\"}", 404, "Not Found");
+        }
+        trace.mark(RequestStage::Route);
+        return jsonResponse(reachableJson(reached.front().city->name, by == "km", reached, static_cast<size_t>(limit)));
+    }
+
+    if (path == "/api/stats") {
+        SeriesKind kind = SeriesKind::Hourly;
+        if (params.count("series") && !SeriesStore::kindFromName(std::string(params.at("series")), kind)) {
+            return jsonResponse("{\"error\":\"series must be hourly, weekly, monthly or yearly\"}", 400, "Bad Request");
+        }
+        size_t slots = SeriesStore::slotCount(kind);
+        size_t from = static_cast<size_t>(std::max(0, parseIntParam(params, "from", 0)));
+        size_t to = static_cast<size_t>(std::max(0, parseIntParam(params, "to", static_cast<int>(slots))));
+        size_t window = static_cast<size_t>(std::max(1, parseIntParam(params, "window", 1)));
+
+        std::vector<double> percentiles = {50, 90, 99};
+        if (params.count("p")) {
+            percentiles.clear();
+            std::stringstream list(std::string(params.at("p")));
+            std::string item;
+            while (std::getline(list, item, ',')) {
+                try {
+                    percentiles.push_back(std::stod(item));
+                } catch (...) {
+                    return jsonResponse("{\"error\":\"p must be a comma separated list of percentiles\"}", 400, "Bad Request");
+                }
+            }
+        }
+
+        SeriesStats stats = engine.seriesStats(kind, from, to, window, percentiles);
+        trace.mark(RequestStage::Route);
+        return jsonResponse(statsJson(stats));
+    }
+
+    if (path == "/api/nearest") {
+        double lat = 0.0;
+        double lon = 0.0;
+        if (!parseDoubleParam(params, "lat", lat) || !parseDoubleParam(params, "lon", lon) ||
+            std::abs(lat) > 90.0 || std::abs(lon) > 180.0) {
+            return jsonResponse("{\"error\":\"nearest requires lat in [-90, 90] and lon in [-180, 180]\"}", 400, "Bad Request");
+        }
+        int k = std::min(100, std::max(1, parseIntParam(params, "k", 5)));
+        std::vector<NearbyCity> cities = engine.nearestCities(lat, lon, static_cast<size_t>(k));
+        trace.mark(RequestStage::Route);
+        return jsonResponse(nearestJson(cities));
+    }
+
+    if (path == "/api/bbox") {
+        double minLat = 0.0;
+        double maxLat = 0.0;
+        double minLon = 0.0;
+        double maxLon = 0.0;
+        if (!parseDoubleParam(params, "min_lat", minLat) || !parseDoubleParam(params, "max_lat", maxLat) ||
+            !parseDoubleParam(params, "min_lon", minLon) || !parseDoubleParam(params, "max_lon", maxLon) ||
+            minLat < -90.0 || maxLat > 90.0 || minLat > maxLat ||
+            std::abs(minLon) > 180.0 || std::abs(maxLon) > 180.0) {
+            return jsonResponse("{\"error\":\"bbox requires -90 <= min_lat <= max_lat <= 90 and min_lon, max_lon in "
+                                "[-180, 180]; min_lon > max_lon wraps across the antimeridian\"}", 400, "Bad Request");
+        }
+        // The spatial index splits a wrapping box into its two halves.
+        int limit = std::min(5000, std::max(1, parseIntParam(params, "limit", 500)));
+        size_t total = 0;
+        std::vector<const City*> cities = engine.citiesInBox(minLat, maxLat, minLon, maxLon, static_cast<size_t>(limit), &total);
+        trace.mark(RequestStage::Route);
+        return jsonResponse(bboxJson(cities, total));
+    }
+
+    if (path == "/api/observations") {
+        std::string_view cityName = paramOr(params, "city", "");
+        const City* record = engine.findCity(cityName);
+        if (!record) {
+            return jsonResponse("{\"error\":\"City not found\"}", 404, "Not Found");
+        }
+        const City& city = *record;
+        if (method == "POST") {
+            int64_t time = 0;
+            int32_t temp = 0;
+            if (!csv::parseNumber(paramOr(params, "time", ""), time) || !csv::parseNumber(paramOr(params, "temp", ""), temp)) {
+                return jsonResponse("{\"error\":\"Observation requires numeric time and temp query params\"}", 400, "Bad Request");
+            }
+            if (time < 0 || time > ObservationHistory::maxTime) {
+                return jsonResponse("{\"error\":\"time must be a unix timestamp between 0 and " +
+                                        std::to_string(ObservationHistory::maxTime) + "\"}",
+                                    400, "Bad Request");
+            }
+            if (observations.pointCount(city.name) >= observations.pointLimit()) {
+                return jsonResponse("{\"error\":\"Observation history for this city is full\"}", 413, "Payload Too Large");
+            }
+            std::string error;
+            if (!observations.append(city.name, time, temp, &error)) {
+                JsonWriter json;
+                json << "{\"error\":\"" << jsonEscape(error) << "\"}";
+                return jsonResponse(json.str(), 409, "Conflict");
+            }
+            trace.mark(RequestStage::Route);
+            return jsonResponse("{\"stored\":" + std::to_string(observations.pointCount(city.name)) + "}", 201, "Created");
+        }
+
+        int64_t from = std::numeric_limits<int64_t>::min();
+        int64_t to = std::numeric_limits<int64_t>::max();
+        try {
+            if (params.count("from")) from = std::stoll(std::string(params.at("from")));
+            if (params.count("to")) to = std::stoll(std::string(params.at("to")));
+        } catch (...) {
+            return jsonResponse("{\"error\":\"from and to must be unix timestamps\"}", 400, "Bad Request");
+        }
+        std::vector<Observation> points = observations.range(city.name, from, to);
+        trace.mark(RequestStage::Route);
+        return jsonResponse(observationsJson(city.name, points));
     }
 
     if (path == "/api/requests") {
-        sendJson(clientSock, stringArrayJson(engine.recentRequests(10)));
-        return;
+        std::vector<std::string> requests = requestLog.recent(10);
+        trace.mark(RequestStage::Route);
+        return jsonResponse(stringArrayJson(requests));
+    }
+
+    if (path == "/api/metrics") {
+        return {Metrics::prometheusText(), 200, "OK", "text/plain; version=0.0.4"};
     }
 
-    sendJson(clientSock, "{\"error\":\"Unknown API endpoint\"}", 404, "Not Found");
+    if (path == "/api/reload") {
+        if (method != "POST") {
+            return jsonResponse("{\"error\":\"Reload requires POST\"}", 405, "Method Not Allowed");
+        }
+        if (!reloader) {
+            return jsonResponse("{\"error\":\"No CSV source to reload from\"}", 409, "Conflict");
+        }
+        reloader->requestReload();
+        return jsonResponse("{\"status\":\"reload scheduled\",\"generation\":" +
+                            std::to_string(engines.generation()) + "}", 202, "Accepted");
+    }
+
+    return jsonResponse("{\"error\":\"Unknown API endpoint\"}", 404, "Not Found");
+}
+
+// Identical concurrent API reads share one computation. Sized from the
+// command line before the server starts.
+std::unique_ptr<SingleFlight<std::string, ApiResponse>> apiFlights;
+
+// Reads whose answer depends only on the engine snapshot and the query.
+bool coalescable(const std::string& method, const std::string& path) {
+    static const std::vector<std::string> paths = {"/api/cities", "/api/weather", "/data", "/api/suggest", "/api/hottest",
+                                                   "/api/coldest", "/api/alerts", "/api/route", "/api/reachable",
+                                                   "/api/stats", "/api/nearest", "/api/bbox"};
+    return method == "GET" && std::find(paths.begin(), paths.end(), path) != paths.end();
+}
+
+// Engine generation, path and the query with keys sorted. City names and
+// the autocomplete prefix are case-folded and trimmed the way the engine
+// looks them up, so city=Lahore and city=lahore%20 share one flight. Fields
+// are length-prefixed because decoded values may contain & or =.
+std::string flightKey(uint64_t generation, const std::string& path,
+                      const QueryParams& params) {
+    std::pmr::vector<const QueryParams::value_type*> sorted(RequestArena::local().resource());
+    sorted.reserve(params.size());
+    for (const auto& param : params) sorted.push_back(&param);
+    std::sort(sorted.begin(), sorted.end(), [](const auto* a, const auto* b) { return *a < *b; });
+
+    std::string key = std::to_string(generation);
+    key += ' ';
+    key += path;
+    std::string normalized;
+    for (const auto* param : sorted) {
+        const std::pmr::string& name = param->first;
+        std::string_view value = param->second;
+        if (name == "city" || name == "from" || name == "to" || name == "q") {
+            normalized = WeatherEngine::normalize(value);
+            value = normalized;
+        }
+        key += ' ';
+        key += std::to_string(name.size());
+        key += ':';
+        key += name;
+        key += std::to_string(value.size());
+        key += ':';
+        key += value;
+    }
+    return key;
+}
+
+// Overload protection, configured from the command line before the server
+// starts. A null limiter is switched off.
+std::unique_ptr<ClientRateLimiter> rateLimiter;
+std::unique_ptr<ConcurrencyLimiter> endpointLimits;
+std::unique_ptr<QueueDelayShedder> shedder;
+
+// The page, metrics and reload stay reachable so an overload can be looked
+// at and fixed. Graph searches are the expensive requests and give way
+// first; everything else, autocomplete included, is interactive.
+RequestPriority priorityOf(const std::string& path) {
+    if (path == "/" || path == "/index.html" || path == "/api/metrics" || path == "/api/reload" ||
+        path == "/api/requests") {
+        return RequestPriority::Critical;
+    }
+    if (path == "/api/route" || path == "/api/reachable") return RequestPriority::Heavy;
+    return RequestPriority::Interactive;
+}
+
+int retryAfterSeconds(double seconds) {
+    return static_cast<int>(std::min(60.0, std::max(1.0, std::ceil(seconds))));
+}
+
+// Checked before anything else, the response cache included, so one client
+// cannot crowd out the others even with cheap requests.
+bool withinRate(const std::string& path, const std::string& client, std::chrono::steady_clock::time_point now,
+                ApiResponse& rejection) {
+    if (!rateLimiter || priorityOf(path) == RequestPriority::Critical) return true;
+    double wait = 0;
+    if (rateLimiter->tryAcquire(client, now, &wait)) return true;
+    Metrics::count(EngineCounter::RateLimited);
+    rejection = jsonResponse("{\"error\":\"Too many requests\"}", 429, "Too Many Requests");
+    rejection.retryAfterSeconds = retryAfterSeconds(wait);
+    return false;
+}
+
+// Feeds the shedder and returns how long the request waited.
+uint64_t observeQueueDelay(std::chrono::steady_clock::time_point received) {
+    const auto now = std::chrono::steady_clock::now();
+    const auto waited = static_cast<uint64_t>(std::max<int64_t>(
+        0, std::chrono::duration_cast<std::chrono::nanoseconds>(now - received).count()));
+    if (shedder) shedder->observe(waited, now);
+    return waited;
+}
+
+ApiResponse unavailable(const std::string& reason, int retryAfter) {
+    ApiResponse response = jsonResponse("{\"error\":\"" + reason + "\"}", 503, "Service Unavailable");
+    response.retryAfterSeconds = retryAfter;
+    return response;
+}
+
+// Runs one API request under its endpoint's concurrency limit.
+ApiResponse limitedApi(const WeatherEngine& engine, const std::string& method, const std::string& path,
+                       const QueryParams& params, RequestTrace& trace) {
+    ConcurrencyLimiter::Slot slot;
+    if (endpointLimits) {
+        const size_t endpoint = routeIndex(path);
+        if (!endpointLimits->tryEnter(endpoint)) {
+            Metrics::count(EngineCounter::ShedConcurrency);
+            return unavailable("Too many concurrent requests for this endpoint", 1);
+        }
+        slot = ConcurrencyLimiter::Slot(endpointLimits.get(), endpoint);
+    }
+    return handleApi(engine, method, path, params, trace);
+}
+
+// Routes one parsed request. indexHtml is only read for the page itself.
+// Requests that reach here are about to compute, so this is where a
+// standing queue sheds them by priority.
+ApiResponse respond(const std::string& method, const std::string& path,
+                    const QueryParams& params,
+                    const std::string& indexHtml, uint64_t queuedNanos, RequestTrace& trace) {
+    if (path.rfind("/api/", 0) == 0 || path == "/data") {
+        if (shedder && shedder->shouldShed(priorityOf(path), queuedNanos)) {
+            Metrics::count(EngineCounter::ShedQueueDelay);
+            return unavailable("Server overloaded", retryAfterSeconds(shedder->standingDelayNanos() / 1e9));
+        }
+        // Pin one engine snapshot for the whole request; a concurrent reload
+        // only affects requests that start after it is published. The flight
+        // is keyed by that snapshot's own generation, so a result computed
+        // from it is never shared under a newer one.
+        SnapshotCell<WeatherEngine>::Versioned pinned = engines.acquireVersioned();
+        const std::shared_ptr<const WeatherEngine>& engine = pinned.value;
+        if (!apiFlights || !coalescable(method, path)) return limitedApi(*engine, method, path, params, trace);
+
+        SingleFlight<std::string, ApiResponse>::Outcome outcome;
+        std::shared_ptr<const ApiResponse> shared = apiFlights->run(
+            flightKey(pinned.generation, path, params),
+            [&] { return limitedApi(*engine, method, path, params, trace); }, &outcome);
+        if (outcome == SingleFlight<std::string, ApiResponse>::Outcome::Joined) {
+            Metrics::count(EngineCounter::CoalescedRequests);
+            trace.mark(RequestStage::Route);
+        } else if (outcome != SingleFlight<std::string, ApiResponse>::Outcome::Led) {
+            Metrics::count(EngineCounter::CoalesceFallbacks);
+        }
+        return *shared;
+    }
+    if (path == "/" || path == "/index.html") {
+        if (indexHtml.empty()) return {"<h1>public/index.html not found</h1>", 500, "Server Error", "text/html"};
+        return {indexHtml, 200, "OK", "text/html"};
+    }
+    return {"404 Not Found", 404, "Not Found", "text/plain"};
 }
 
-void handleClient(SOCKET clientSock, const std::string& indexPath) {
+void handleClient(SOCKET clientSock, const std::string& client, std::chrono::steady_clock::time_point accepted,
+                  const std::string& indexPath) {
+    RequestArena::Scope arena;
+    RequestTrace trace;
     char buffer[4096];
     int bytesReceived = recv(clientSock, buffer, sizeof(buffer), 0);
     if (bytesReceived <= 0) {
@@ -299,55 +1034,326 @@ void handleClient(SOCKET clientSock, const std::string& indexPath) {
     std::string method;
     std::string url;
     requestStream >> method >> url;
-    engine.logRequest(method + " " + url);
+    requestLog.push(method, url);
 
     const std::string path = SimpleServer::pathOnly(url);
-    const auto params = SimpleServer::parseQuery(url);
+    const QueryParams params = SimpleServer::parseQuery(url, arena.resource());
+    trace.mark(RequestStage::Parse);
 
-    if (path.rfind("/api/", 0) == 0 || path == "/data") {
-        handleApi(clientSock, path, params);
-    } else if (path == "/" || path == "/index.html") {
-        std::string html = SimpleServer::loadTextFile(indexPath);
-        if (html.empty()) {
-            SimpleServer::sendResponse(clientSock, "<h1>public/index.html not found</h1>", "text/html", 500, "Server Error");
-        } else {
-            SimpleServer::sendResponse(clientSock, html, "text/html");
-        }
-    } else {
-        SimpleServer::sendResponse(clientSock, "404 Not Found", "text/plain", 404, "Not Found");
+    const uint64_t queued = observeQueueDelay(accepted);
+    ApiResponse response;
+    if (withinRate(path, client, std::chrono::steady_clock::now(), response)) {
+        const bool page = path == "/" || path == "/index.html";
+        response = respond(method, path, params, page ? SimpleServer::loadTextFile(indexPath) : std::string(), queued,
+                           trace);
     }
+    trace.mark(RequestStage::Serialize);
 
+    SimpleServer::sendResponse(clientSock, response.body, response.contentType, response.statusCode, response.statusText,
+                               response.retryAfterSeconds);
+    trace.mark(RequestStage::Send);
     closesocket(clientSock);
+    trace.finish(routeIndex(path), response.statusCode);
+}
+
+// Answers that depend on nothing but the engine snapshot, so a reactor may
+// replay them until the next reload. /api/weather is left out because it
+// folds in observations, which change between reloads.
+bool cacheableResponse(const std::string& method, const std::string& path) {
+    static const std::vector<std::string> paths = {"/api/cities", "/api/suggest", "/api/hottest", "/api/coldest",
+                                                   "/api/alerts", "/api/route", "/api/reachable", "/api/stats",
+                                                   "/api/nearest", "/api/bbox"};
+    return method == "GET" && std::find(paths.begin(), paths.end(), path) != paths.end();
+}
+
+// State one reactor keeps to itself, so its hot path shares nothing with the
+// others: the page it serves and the responses it has produced for the
+// current engine generation. Only the owning reactor's thread touches it.
+struct ReactorCache {
+    static constexpr size_t capacity = 4096;
+
+    std::string indexHtml;
+    uint64_t generation = 0;
+    std::unordered_map<std::string, ApiResponse> responses;
+};
+
+// Replays the reactor's cached answer when it has one. A cache hit costs
+// next to nothing, so it is served however backed up the queue is.
+// On a miss the response is computed into computed, and that is returned.
+const ApiResponse& cachedOrRespond(ReactorCache& cache, const HttpRequestHead& request, const std::string& path,
+                                   uint64_t queuedNanos, RequestTrace& trace, ApiResponse& computed) {
+    const bool cacheable = cacheableResponse(request.method, path);
+    if (cacheable) {
+        const uint64_t generation = engines.generation();
+        if (generation != cache.generation || cache.responses.size() >= ReactorCache::capacity) {
+            cache.responses.clear();
+            cache.generation = generation;
+        }
+        auto cached = cache.responses.find(request.url);
+        if (cached != cache.responses.end()) {
+            Metrics::count(EngineCounter::ResponseCacheHits);
+            trace.mark(RequestStage::Route);
+            return cached->second;
+        }
+    }
+
+    const QueryParams params = SimpleServer::parseQuery(request.url, RequestArena::local().resource());
+    trace.mark(RequestStage::Parse);
+    computed = respond(request.method, path, params, cache.indexHtml, queuedNanos, trace);
+    if (cacheable && computed.statusCode == 200) cache.responses.emplace(request.url, computed);
+    return computed;
+}
+
+// Serializes straight into the connection's output buffer.
+void handleReactorRequest(ReactorCache& cache, const HttpRequestHead& request, std::string& out) {
+    RequestArena::Scope arena;
+    RequestTrace trace;
+    requestLog.push(request.method, request.url);
+    const std::string path = SimpleServer::pathOnly(request.url);
+
+    const uint64_t queued = observeQueueDelay(request.received);
+    ApiResponse computed;
+    const ApiResponse* response = &computed;
+    if (withinRate(path, request.client, std::chrono::steady_clock::now(), computed)) {
+        response = &cachedOrRespond(cache, request, path, queued, trace, computed);
+    }
+
+    SimpleServer::appendResponse(out, response->body, response->contentType, response->statusCode,
+                                 response->statusText, request.keepAlive, response->retryAfterSeconds);
+    trace.mark(RequestStage::Serialize);
+    trace.finish(routeIndex(path), response->statusCode);
 }
 
 void stopServer(int) {
     running = false;
 }
+
+struct ServerOptions {
+    std::string dataPath;
+    std::string routesPath;
+    std::string loadSnapshotPath;
+    std::string saveSnapshotPath;
+    std::string observationsPath;
+    int watchMs = 1000;
+    int port = 8080;
+    int backlog = SOMAXCONN;
+    int reactors = -1;  // -1: one blocking accept loop; 0: one reactor per core
+    bool pinReactors = true;
+    int idleTimeoutMs = 30000;  // reactor mode: close connections idle this long
+    int coalesceWaiters = 256;  // 0 turns coalescing off
+    int coalesceTimeoutMs = 100;  // a waiting follower stalls its whole reactor
+    double rateLimit = 0;  // requests per second per client; 0 turns it off
+    double rateBurst = 0;  // 0: twice the rate
+    int shedTargetMs = 0;  // 0 leaves queue-delay shedding off
+    int shedIntervalMs = 500;
+    bool limitHeavy = false;  // heavy endpoints get at most half the workers
+    std::vector<std::pair<std::string, int>> endpointLimits;  // e.g. /api/route=4
+};
+
+bool parseServerOptions(int argc, char** argv, ServerOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--data" && i + 1 < argc) {
+            options.dataPath = argv[++i];
+        } else if (arg == "--routes" && i + 1 < argc) {
+            options.routesPath = argv[++i];
+        } else if (arg == "--load-snapshot" && i + 1 < argc) {
+            options.loadSnapshotPath = argv[++i];
+        } else if (arg == "--save-snapshot" && i + 1 < argc) {
+            options.saveSnapshotPath = argv[++i];
+        } else if (arg == "--observations" && i + 1 < argc) {
+            options.observationsPath = argv[++i];
+        } else if (arg == "--watch-ms" && i + 1 < argc) {
+            options.watchMs = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--port" && i + 1 < argc) {
+            options.port = std::atoi(argv[++i]);
+        } else if (arg == "--backlog" && i + 1 < argc) {
+            options.backlog = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--reactors" && i + 1 < argc) {
+            std::string value = argv[++i];
+            options.reactors = value == "auto" ? 0 : std::max(1, std::atoi(value.c_str()));
+        } else if (arg == "--no-affinity") {
+            options.pinReactors = false;
+        } else if (arg == "--idle-timeout-ms" && i + 1 < argc) {
+            options.idleTimeoutMs = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--coalesce-waiters" && i + 1 < argc) {
+            options.coalesceWaiters = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--coalesce-timeout-ms" && i + 1 < argc) {
+            options.coalesceTimeoutMs = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--rate-limit" && i + 1 < argc) {
+            options.rateLimit = std::max(0.0, std::atof(argv[++i]));
+        } else if (arg == "--rate-burst" && i + 1 < argc) {
+            options.rateBurst = std::max(0.0, std::atof(argv[++i]));
+        } else if (arg == "--shed-target-ms" && i + 1 < argc) {
+            options.shedTargetMs = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--shed-interval-ms" && i + 1 < argc) {
+            options.shedIntervalMs = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--limit-heavy") {
+            options.limitHeavy = true;
+        } else if (arg == "--limit" && i + 1 < argc) {
+            std::string value = argv[++i];
+            size_t eq = value.find('=');
+            std::string path = value.substr(0, eq);
+            if (eq == std::string::npos || routeIndex(path) + 1 == routeNames.size()) {
+                std::cerr << "--limit expects PATH=N with a known API path, got " << value << std::endl;
+                return false;
+            }
+            options.endpointLimits.push_back({path, std::max(0, std::atoi(value.c_str() + eq + 1))});
+        } else {
+            std::cerr << "usage: weather_dashboard [--data cities.csv] [--routes routes.csv] [--load-snapshot engine.snap]"
+                         " [--save-snapshot engine.snap] [--observations history.csv] [--watch-ms 1000]"
+                         " [--port 8080] [--backlog N] [--reactors N|auto] [--no-affinity] [--idle-timeout-ms 30000]"
+                         " [--coalesce-waiters 256] [--coalesce-timeout-ms 100] [--rate-limit R] [--rate-burst N]"
+                         " [--shed-target-ms 50] [--shed-interval-ms 500] [--limit-heavy] [--limit PATH=N]..." << std::endl;
+            return false;
+        }
+    }
+    if (options.port <= 0 || options.port > 65535) {
+        std::cerr << "--port must be between 1 and 65535" << std::endl;
+        return false;
+    }
+    return true;
+}
 }
 
-int main() {
+int main(int argc, char** argv) {
     std::signal(SIGINT, stopServer);
 
-    const std::string dataPath = findExistingPath({"data/weather_data.csv", "../data/weather_data.csv"});
+    ServerOptions options;
+    if (!parseServerOptions(argc, argv, options)) return 2;
+
+    const std::string dataPath = !options.dataPath.empty()
+        ? options.dataPath
+        : findExistingPath({"data/weather_data.csv", "../data/weather_data.csv"});
+    const std::string routesPath = !options.routesPath.empty()
+        ? options.routesPath
+        : options.dataPath.empty() ? findExistingPath({"data/routes.csv", "../data/routes.csv"}) : "";
     const std::string indexPath = findExistingPath({"public/index.html", "../public/index.html", "index.html"});
+    const DataSource source {dataPath, routesPath};
 
-    if (dataPath.empty()) {
-        std::cerr << "Could not find data/weather_data.csv" << std::endl;
-        return 1;
+    Metrics::setRouteNames(routeNames);
+
+    std::string sourcePath = dataPath;
+    std::shared_ptr<WeatherEngine> initial;
+    if (!options.loadSnapshotPath.empty()) {
+        auto started = std::chrono::steady_clock::now();
+        std::string snapshotError;
+        initial = std::make_shared<WeatherEngine>();
+        if (!EngineSnapshot::load(*initial, options.loadSnapshotPath, &snapshotError)) {
+            std::cerr << options.loadSnapshotPath << ": " << snapshotError << std::endl;
+            return 1;
+        }
+        sourcePath = options.loadSnapshotPath;
+        std::cout << "Restored snapshot in "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count()
+                  << " ms" << std::endl;
+    } else {
+        if (dataPath.empty()) {
+            std::cerr << "Could not find data/weather_data.csv" << std::endl;
+            return 1;
+        }
+        initial = buildFromCsv(source);
+        if (!initial) return 1;
     }
 
-    std::string loadError;
-    if (!engine.loadCitiesFromCsv(dataPath, &loadError)) {
-        std::cerr << loadError << std::endl;
-        return 1;
+    if (!options.saveSnapshotPath.empty()) {
+        std::string snapshotError;
+        if (!EngineSnapshot::save(*initial, options.saveSnapshotPath, &snapshotError)) {
+            std::cerr << snapshotError << std::endl;
+            return 1;
+        }
+        std::cout << "Saved snapshot to " << options.saveSnapshotPath << std::endl;
+    }
+    if (!options.observationsPath.empty()) {
+        CsvLoadReport observationReport;
+        std::string observationError;
+        const WeatherEngine& known = *initial;
+        if (!observations.loadCsv(options.observationsPath, observationReport,
+                                  [&](const std::string& city) { return known.hasCity(city); }, &observationError)) {
+            std::cerr << observationError << std::endl;
+            return 1;
+        }
+        printRowErrors(options.observationsPath, observationReport);
+        std::cout << "Loaded " << observationReport.rowsLoaded << " observations" << std::endl;
+    }
+
+    const size_t cityCount = initial->citiesByName().size();
+    engines.publish(std::move(initial));
+
+    std::unique_ptr<Reloader> csvReloader;
+    if (!dataPath.empty()) {
+        csvReloader = std::make_unique<Reloader>(source, std::chrono::milliseconds(options.watchMs));
+        csvReloader->start();
+        reloader = csvReloader.get();
     }
-    seedRoutesAndAlerts();
 
     if (!SimpleServer::initNetwork()) {
         std::cerr << "Failed to initialize network stack" << std::endl;
         return 1;
     }
 
+    if (options.coalesceWaiters > 0) {
+        apiFlights = std::make_unique<SingleFlight<std::string, ApiResponse>>(
+            static_cast<size_t>(options.coalesceWaiters), std::chrono::milliseconds(options.coalesceTimeoutMs));
+    }
+
+    // Admission control is opt-in. With --limit-heavy, heavy endpoints get
+    // at most half the worker threads, so the rest stay free for
+    // interactive requests; --limit overrides single endpoints.
+    const size_t workers = options.reactors < 0 ? 1
+        : options.reactors > 0 ? static_cast<size_t>(options.reactors) : std::max(1u, std::thread::hardware_concurrency());
+    if (options.limitHeavy || !options.endpointLimits.empty()) {
+        endpointLimits = std::make_unique<ConcurrencyLimiter>(routeNames.size());
+        for (size_t i = 0; options.limitHeavy && i < routeNames.size(); i++) {
+            if (priorityOf(routeNames[i]) == RequestPriority::Heavy) {
+                endpointLimits->setLimit(i, static_cast<int>(std::max<size_t>(1, workers / 2)));
+            }
+        }
+        for (const auto& limit : options.endpointLimits) endpointLimits->setLimit(routeIndex(limit.first), limit.second);
+    }
+    if (options.rateLimit > 0) {
+        rateLimiter = std::make_unique<ClientRateLimiter>(
+            options.rateLimit, options.rateBurst > 0 ? options.rateBurst : 2 * options.rateLimit);
+    }
+    if (options.shedTargetMs > 0) {
+        shedder = std::make_unique<QueueDelayShedder>(std::chrono::milliseconds(options.shedTargetMs),
+                                                      std::chrono::milliseconds(options.shedIntervalMs));
+    }
+
+    if (options.reactors >= 0) {
+        ReactorServer::Options reactorOptions;
+        reactorOptions.port = options.port;
+        reactorOptions.backlog = options.backlog;
+        reactorOptions.reactors = workers;
+        reactorOptions.pinThreads = options.pinReactors;
+        reactorOptions.idleTimeoutMs = options.idleTimeoutMs;
+
+        const std::string indexHtml = SimpleServer::loadTextFile(indexPath);
+        std::vector<ReactorCache> caches(reactorOptions.reactors);
+        for (ReactorCache& cache : caches) cache.indexHtml = indexHtml;
+
+        ReactorServer server;
+        std::string serverError;
+        if (!server.start(reactorOptions, [&](size_t reactor, const HttpRequestHead& request, std::string& out) {
+                handleReactorRequest(caches[reactor], request, out);
+            }, &serverError)) {
+            std::cerr << serverError << std::endl;
+            SimpleServer::cleanupNetwork();
+            return 1;
+        }
+
+        std::cout << "DSA Weather Analytics Dashboard running at http://localhost:" << options.port << " with "
+                  << server.reactorCount() << " reactors" << std::endl;
+        std::cout << "Loaded " << cityCount << " cities from " << sourcePath << std::endl;
+        while (running) std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+        server.stop();
+        reloader = nullptr;
+        if (csvReloader) csvReloader->stop();
+        SimpleServer::cleanupNetwork();
+        return 0;
+    }
+
     SOCKET serverSock = socket(AF_INET, SOCK_STREAM, 0);
     if (serverSock == INVALID_SOCKET) {
         std::cerr << "Failed to create server socket" << std::endl;
@@ -355,35 +1361,44 @@ int main() {
         return 1;
     }
 
+    // Lets a restarted server bind while connections from the previous run
+    // are still in TIME_WAIT.
+    int reuse = 1;
+    setsockopt(serverSock, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
     sockaddr_in serverAddr {};
     serverAddr.sin_family = AF_INET;
-    serverAddr.sin_port = htons(8080);
+    serverAddr.sin_port = htons(static_cast<uint16_t>(options.port));
     serverAddr.sin_addr.s_addr = INADDR_ANY;
 
     if (bind(serverSock, reinterpret_cast<sockaddr*>(&serverAddr), sizeof(serverAddr)) == SOCKET_ERROR) {
-        std::cerr << "Could not bind to port 8080. Is another server already running?" << std::endl;
+        std::cerr << "Could not bind to port " << options.port << ". Is another server already running?" << std::endl;
         closesocket(serverSock);
         SimpleServer::cleanupNetwork();
         return 1;
     }
 
-    if (listen(serverSock, 10) == SOCKET_ERROR) {
-        std::cerr << "Failed to listen on port 8080" << std::endl;
+    if (listen(serverSock, options.backlog) == SOCKET_ERROR) {
+        std::cerr << "Failed to listen on port " << options.port << std::endl;
         closesocket(serverSock);
         SimpleServer::cleanupNetwork();
         return 1;
     }
 
-    std::cout << "DSA Weather Analytics Dashboard running at http://localhost:8080" << std::endl;
-    std::cout << "Loaded " << engine.getAllCities().size() << " cities from " << dataPath << std::endl;
+    std::cout << "DSA Weather Analytics Dashboard running at http://localhost:" << options.port << std::endl;
+    std::cout << "Loaded " << cityCount << " cities from " << sourcePath << std::endl;
     std::cout << "API examples: /api/weather?city=Lahore, /api/route?from=Topi&to=Karachi" << std::endl;
 
     while (running) {
-        SOCKET clientSock = accept(serverSock, nullptr, nullptr);
+        sockaddr_in peer {};
+        socklen_t peerLength = sizeof(peer);
+        SOCKET clientSock = accept(serverSock, reinterpret_cast<sockaddr*>(&peer), &peerLength);
         if (clientSock == INVALID_SOCKET) continue;
-        handleClient(clientSock, indexPath);
+        handleClient(clientSock, SimpleServer::addressText(peer), std::chrono::steady_clock::now(), indexPath);
     }
 
+    reloader = nullptr;
+    if (csvReloader) csvReloader->stop();
     closesocket(serverSock);
     SimpleServer::cleanupNetwork();
     return 0;
@@ -1,45 +1,54 @@
+#include "AdmissionControl.hpp"
+#include "EngineSnapshot.hpp"
+#include "ObservationStore.hpp"
+#include "ReactorServer.hpp"
+#include "RequestArena.hpp"
+#include "SingleFlight.hpp"
+#include "SnapshotCell.hpp"
 #include "WeatherEngine.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <random>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <vector>
 
 namespace {
-std::string findDataPath() {
+std::string findDataPath(const std::string& file) {
     const std::string paths[] = {
-        "data/weather_data.csv",
-        "../data/weather_data.csv",
-        "../../data/weather_data.csv"
+        "data/" + file,
+        "../data/" + file,
+        "../../data/" + file
     };
 
     for (const std::string& path : paths) {
-        std::ifstream file(path);
-        if (file.good()) return path;
+        std::ifstream stream(path);
+        if (stream.good()) return path;
     }
 
-    return "data/weather_data.csv";
+    return "data/" + file;
 }
 
 void buildEngine(WeatherEngine& engine) {
     std::string error;
-    assert(engine.loadCitiesFromCsv(findDataPath(), &error) && "CSV data should load");
-
-    engine.addRoute("Islamabad", "Peshawar");
-    engine.addRoute("Islamabad", "Lahore");
-    engine.addRoute("Islamabad", "Topi");
-    engine.addRoute("Islamabad", "Rawalpindi");
-    engine.addRoute("Peshawar", "Topi");
-    engine.addRoute("Rawalpindi", "Lahore");
-    engine.addRoute("Lahore", "Multan");
-    engine.addRoute("Lahore", "Faisalabad");
-    engine.addRoute("Faisalabad", "Multan");
-    engine.addRoute("Multan", "Hyderabad");
-    engine.addRoute("Hyderabad", "Karachi");
-    engine.addRoute("Karachi", "Quetta");
-    engine.addRoute("Quetta", "Multan");
-    engine.addRoute("Lahore", "Karachi", 90, 1020);
-    engine.addRoute("Faisalabad", "Karachi", 75, 945);
+    assert(engine.loadCitiesFromCsv(findDataPath("weather_data.csv"), &error) && "CSV data should load");
+
+    CsvLoadReport routes;
+    assert(engine.loadRoutesFromCsv(findDataPath("routes.csv"), routes, &error) && "route network should load");
+    assert(routes.rowsLoaded == 15);
+    assert(routes.errors.empty());
 
     engine.addAlert(9, "Heat advisory", "Multan");
     engine.addAlert(4, "Light rain", "Islamabad");
@@ -64,6 +73,25 @@ int main() {
     auto neighbors = engine.getNeighbors("Islamabad");
     assert(neighbors.size() == 4);
 
+    bool foundCorridor = false;
+    for (const RouteEdge& edge : engine.getNeighbors("Lahore")) {
+        if (edge.city == "Karachi") {
+            foundCorridor = edge.weatherRisk == 90 && edge.distanceKm == 1020;
+        }
+    }
+    assert(foundCorridor);
+
+    {
+        WeatherEngine bulk;
+        assert(bulk.loadCitiesFromCsv(findDataPath("weather_data.csv")));
+        std::vector<size_t> rejected;
+        size_t added = bulk.addRoutes({{"Topi", "Peshawar"}, {"Topi", "Atlantis"}, {"Multan", "Quetta", 4, 380.0}}, &rejected);
+        assert(added == 2);
+        assert(rejected.size() == 1 && rejected[0] == 1);
+        assert(bulk.getNeighbors("topi").size() == 1);
+        assert(bulk.getNeighbors("Quetta")[0].weatherRisk == 4);
+    }
+
     auto bfs = engine.shortestRouteBfs("Topi", "Karachi");
     assert(!bfs.empty());
     assert(bfs.front() == "Topi");
@@ -80,6 +108,207 @@ int main() {
     assert(safest.path.back() == "Karachi");
     assert(safest.totalRisk < bfsSummary.totalRisk);
 
+    {
+        using Flights = SingleFlight<std::string, int>;
+        Flights flights(2, std::chrono::milliseconds(5000));
+        std::atomic<int> computed {0};
+        std::atomic<bool> release {false};
+        std::vector<Flights::Outcome> outcomes(4, Flights::Outcome::Led);
+        std::vector<std::shared_ptr<const int>> results(4);
+        auto slow = [&] {
+            computed++;
+            while (!release) std::this_thread::yield();
+            return 42;
+        };
+
+        std::vector<std::thread> callers;
+        callers.emplace_back([&] { results[0] = flights.run("route", slow, &outcomes[0]); });
+        while (flights.inFlight() == 0) std::this_thread::yield();
+        for (int i = 1; i <= 2; i++) {
+            callers.emplace_back([&, i] { results[i] = flights.run("route", slow, &outcomes[i]); });
+        }
+        while (flights.waiting("route") < 2) std::this_thread::yield();
+        // A third follower is over the bound and computes its own answer.
+        results[3] = flights.run("route", [] { return 7; }, &outcomes[3]);
+        release = true;
+        for (std::thread& caller : callers) caller.join();
+
+        assert(computed == 1 && flights.inFlight() == 0);
+        assert(outcomes[0] == Flights::Outcome::Led && outcomes[1] == Flights::Outcome::Joined);
+        assert(outcomes[2] == Flights::Outcome::Joined && outcomes[3] == Flights::Outcome::Overflowed);
+        assert(results[1] == results[0] && results[2] == results[0] && *results[0] == 42 && *results[3] == 7);
+
+        Flights impatient(8, std::chrono::milliseconds(1));
+        release = false;
+        std::thread leader([&] { impatient.run("weather", slow); });
+        while (impatient.inFlight() == 0) std::this_thread::yield();
+        Flights::Outcome outcome = Flights::Outcome::Led;
+        assert(*impatient.run("weather", [] { return 1; }, &outcome) == 1 && outcome == Flights::Outcome::TimedOut);
+        release = true;
+        leader.join();
+
+        bool threw = false;
+        try {
+            flights.run("broken", []() -> int { throw std::runtime_error("no route"); });
+        } catch (const std::runtime_error&) {
+            threw = true;
+        }
+        assert(threw && flights.inFlight() == 0);
+    }
+
+    {
+        using Clock = std::chrono::steady_clock;
+        const Clock::time_point t0 = Clock::now();
+        ClientRateLimiter limiter(10.0, 3.0);
+        double wait = 0;
+        for (int i = 0; i < 3; i++) assert(limiter.tryAcquire("10.0.0.1", t0));
+        assert(!limiter.tryAcquire("10.0.0.1", t0, &wait) && std::abs(wait - 0.1) < 1e-9);
+        assert(limiter.tryAcquire("10.0.0.2", t0));
+        assert(limiter.tryAcquire("10.0.0.1", t0 + std::chrono::milliseconds(100)));
+        assert(!limiter.tryAcquire("10.0.0.1", t0 + std::chrono::milliseconds(100)));
+        assert(limiter.tryAcquire("10.0.0.1", t0 + std::chrono::seconds(10)) && limiter.trackedClients() == 2);
+        assert(ClientRateLimiter(0.0, 1.0).tryAcquire("anyone", t0));
+        ClientRateLimiter bounded(1.0, 1.0, 32);
+        for (int i = 0; i < 1000; i++) bounded.tryAcquire("10.1." + std::to_string(i / 256) + "." + std::to_string(i % 256), t0);
+        assert(bounded.trackedClients() <= 32);
+        assert(bounded.tryAcquire("10.2.0.1", t0) && !bounded.tryAcquire("10.2.0.1", t0));
+
+        ConcurrencyLimiter limits(3);
+        limits.setLimit(1, 2);
+        assert(limits.tryEnter(1) && limits.tryEnter(1) && !limits.tryEnter(1) && limits.active(1) == 2);
+        {
+            ConcurrencyLimiter::Slot held(&limits, 1);
+            ConcurrencyLimiter::Slot moved = std::move(held);
+        }
+        assert(limits.active(1) == 1 && limits.tryEnter(1));
+        for (int i = 0; i < 100; i++) assert(limits.tryEnter(0));
+
+        // A burst that drains within the interval is tolerated; a queue that
+        // never drops below target for a whole interval is shed, heavy
+        // requests first, and only those that actually waited.
+        QueueDelayShedder shedder(std::chrono::milliseconds(5), std::chrono::milliseconds(100), 4);
+        const uint64_t ms = 1000000;
+        shedder.observe(0, t0);
+        shedder.observe(40 * ms, t0 + std::chrono::milliseconds(10));
+        shedder.observe(1 * ms, t0 + std::chrono::milliseconds(50));
+        shedder.observe(30 * ms, t0 + std::chrono::milliseconds(150));
+        assert(shedder.standingDelayNanos() == 0 && !shedder.shouldShed(RequestPriority::Heavy, 30 * ms));
+        shedder.observe(10 * ms, t0 + std::chrono::milliseconds(200));
+        shedder.observe(30 * ms, t0 + std::chrono::milliseconds(300));
+        assert(shedder.standingDelayNanos() == 10 * ms);
+        assert(shedder.shouldShed(RequestPriority::Heavy, 30 * ms) && !shedder.shouldShed(RequestPriority::Heavy, 1 * ms));
+        assert(!shedder.shouldShed(RequestPriority::Interactive, 30 * ms));
+        shedder.observe(50 * ms, t0 + std::chrono::milliseconds(420));
+        assert(shedder.shouldShed(RequestPriority::Interactive, 50 * ms));
+        assert(!shedder.shouldShed(RequestPriority::Critical, 50 * ms));
+        shedder.observe(0, t0 + std::chrono::milliseconds(480));
+        shedder.observe(0, t0 + std::chrono::milliseconds(600));
+        assert(!shedder.shouldShed(RequestPriority::Heavy, 50 * ms));
+    }
+
+    {
+        const std::string pipelined = "GET /api/cities HTTP/1.1\r\nHost: x\r\n\r\n"
+                                      "POST /api/observations?city=Lahore HTTP/1.1\r\ncontent-LENGTH: 4\r\nConnection: Close\r\n\r\nbody"
+                                      "GET / HTTP/1.0\r\n\r\n";
+        HttpRequestHead head;
+        size_t bodyLength = 0;
+        size_t end = pipelined.find("\r\n\r\n");
+        assert(ReactorServer::parseHead(pipelined, 0, end, head, bodyLength));
+        assert(head.method == "GET" && head.url == "/api/cities" && head.keepAlive && bodyLength == 0);
+        size_t start = end + 4;
+        end = pipelined.find("\r\n\r\n", start);
+        assert(ReactorServer::parseHead(pipelined, start, end, head, bodyLength));
+        assert(head.method == "POST" && !head.keepAlive && bodyLength == 4);
+        start = end + 4 + bodyLength;
+        end = pipelined.find("\r\n\r\n", start);
+        assert(ReactorServer::parseHead(pipelined, start, end, head, bodyLength) && head.url == "/" && !head.keepAlive);
+        const std::string garbage = "NONSENSE\r\n\r\n";
+        assert(!ReactorServer::parseHead(garbage, 0, garbage.find("\r\n\r\n"), head, bodyLength));
+    }
+
+    {
+        RouteResult today = engine.safestRouteOnDay("Topi", "Karachi", 0);
+        assert(today.found && today.path.front() == "Topi" && today.path.back() == "Karachi");
+        assert(today.totalRisk >= safest.totalRisk && today.departDay == 0);
+        assert(today.arrivalDay == std::min(static_cast<int>(WeatherEngine::forecastDays) - 1,
+                                            static_cast<int>(today.totalDistanceKm / WeatherEngine::travelKmPerDay)));
+        RouteResult summary = engine.summarizePath(today.path);
+        assert(summary.found && std::abs(summary.totalDistanceKm - today.totalDistanceKm) < 1e-6);
+        assert(!engine.safestRouteOnDay("Topi", "Karachi", static_cast<int>(WeatherEngine::forecastDays)).found);
+        assert(!engine.safestRouteOnDay("Topi", "Atlantis", 0).found);
+        const int lastDay = static_cast<int>(WeatherEngine::forecastDays) - 1;
+        RouteResult late = engine.safestRouteOnDay("Topi", "Karachi", lastDay);
+        assert(late.found && late.totalDistanceKm > WeatherEngine::travelKmPerDay && late.arrivalDay == lastDay);
+
+        // A storm forecast on the first days makes the direct corridor worse
+        // than going around; leaving after it clears restores it.
+        WeatherEngine stormy;
+        const int riskA = 5;
+        for (const char* name : {"Alpha", "Beta", "Gamma"}) {
+            City city = lahore;
+            city.name = name;
+            city.tenDayForecast = lahore.tenDayForecast;
+            for (DailyForecast& day : city.tenDayForecast) day.rainProbability = 0;
+            if (city.name == "Beta") {
+                for (size_t d = 0; d < 3; d++) city.tenDayForecast[d].rainProbability = 100;
+            }
+            stormy.addCity(city);
+        }
+        stormy.addRoute("Alpha", "Beta", riskA, 100.0);
+        stormy.addRoute("Beta", "Gamma", riskA, 100.0);
+        stormy.addRoute("Alpha", "Gamma", 3 * riskA, 200.0);
+        RouteResult wet = stormy.safestRouteOnDay("Alpha", "Gamma", 0);
+        RouteResult dry = stormy.safestRouteOnDay("Alpha", "Gamma", 5);
+        assert(wet.found && wet.path.size() == 2);
+        assert(dry.found && dry.path.size() == 3 && dry.arrivalDay == 5);
+
+        // Waiting out the storm: looping back through Start reaches Mid a day
+        // later, when both legs are dry, which beats the first arrival at Mid.
+        WeatherEngine detour;
+        for (const char* name : {"Start", "Detour", "Mid", "End"}) {
+            City city = lahore;
+            city.name = name;
+            city.tenDayForecast = lahore.tenDayForecast;
+            for (DailyForecast& day : city.tenDayForecast) {
+                day.high = 30;
+                day.low = 10;
+                day.rainProbability = 0;
+            }
+            if (city.name == "Mid" || city.name == "End") city.tenDayForecast[0].rainProbability = 100;
+            detour.addCity(city);
+        }
+        detour.addRoute("Start", "Mid", 1, 100.0);
+        detour.addRoute("Start", "Detour", 1, 300.0);
+        detour.addRoute("Mid", "End", 1, 100.0);
+        RouteResult waited = detour.safestRouteOnDay("Start", "End", 0);
+        assert(waited.found && waited.totalRisk == 4 && waited.arrivalDay == 1);
+        assert(waited.path == std::vector<std::string>({"Start", "Detour", "Start", "Mid", "End"}));
+    }
+
+    {
+        std::vector<ReachableCity> reached;
+        assert(!engine.reachableCities("Atlantis", 100, 1e9, reached) && reached.empty());
+        assert(engine.reachableCities("Topi", std::numeric_limits<int>::max(), 1e9, reached));
+        assert(reached.size() == engine.citiesByName().size());
+        assert(reached[0].city->name == "Topi" && !reached[0].via && reached[0].risk == 0);
+        for (size_t i = 1; i < reached.size(); i++) {
+            assert(reached[i - 1].risk <= reached[i].risk && reached[i].via && reached[i].hops > 0);
+            RouteResult best = engine.safestRouteDijkstra("Topi", reached[i].city->name);
+            assert(best.found && best.totalRisk == reached[i].risk);
+        }
+
+        size_t everything = reached.size();
+        assert(engine.reachableCities("topi", safest.totalRisk - 1, 1e9, reached));
+        assert(reached.size() < everything);
+        for (const ReachableCity& city : reached) assert(city.risk < safest.totalRisk && city.city->name != "Karachi");
+
+        assert(engine.reachableCities("Lahore", std::numeric_limits<int>::max(), 1100.0, reached, true));
+        for (size_t i = 1; i < reached.size(); i++) {
+            assert(reached[i - 1].distanceKm <= reached[i].distanceKm && reached[i].distanceKm <= 1100.0);
+        }
+        assert(std::any_of(reached.begin(), reached.end(), [](const ReachableCity& c) { return c.city->name == "Karachi" && c.hops == 1; }));
+    }
+
     auto alerts = engine.getTopAlerts(2);
     assert(alerts.size() == 2);
     assert(alerts[0].severity >= alerts[1].severity);
@@ -88,11 +317,355 @@ int main() {
     assert(hottest.size() == 3);
     assert(hottest[0].temp >= hottest[1].temp);
 
+    assert(Metrics::engineTotal(EngineCounter::DijkstraNodesExpanded) > 0);
+    assert(Metrics::engineTotal(EngineCounter::TrieNodesVisited) >= 3);
+
+    LatencyHistogram histogram;
+    for (uint64_t value : {5u, 100u, 1000u, 1000000u}) histogram.record(value);
+    HistogramSnapshot snapshot;
+    histogram.addTo(snapshot.counts, snapshot.count, snapshot.sum);
+    assert(snapshot.count == 4);
+    assert(snapshot.sum == 1001105);
+    assert(snapshot.valueAtPercentile(50) >= 100 && snapshot.valueAtPercentile(50) < 113);
+    assert(snapshot.valueAtPercentile(100) >= 1000000 && snapshot.valueAtPercentile(100) < 1125000);
+
     engine.logRequest("GET /api/weather?city=Topi");
     auto logs = engine.recentRequests();
     assert(!logs.empty());
     assert(logs[0] == "GET /api/weather?city=Topi");
 
+    {
+        const std::string csvPath = "weather_engine_tests_rows.csv";
+        std::ofstream csv(csvPath);
+        csv << "City,Lat,Lon,Temp,Condition,Wind,Humidity,AQI,Rain,WindDir\r\n"
+            << "Gilgit,35.92,74.31,12,Cloudy,9,48,40,1.5,30\r\n"
+            << "\n"
+            << "Sukkur,27.70,68.86,hot,Sunny,7,30,160,0.0,200\n"
+            << "Chitral,35.85,71.78,9\n"
+            << "\"Dera Ghazi Khan\",30.05,70.63,36,Hot,6,25,190,0.0,180";
+        csv.close();
+
+        WeatherEngine mapped;
+        CsvLoadReport report;
+        assert(mapped.loadCitiesFromCsvMapped(csvPath, report, 4));
+        assert(report.rowsLoaded == 2);
+        assert(report.errors.size() == 2);
+        assert(report.errors[0].line == 4);
+        assert(report.errors[1].line == 5);
+
+        City gilgit;
+        assert(mapped.getCity("gilgit", gilgit));
+        assert(gilgit.hourlyData.size() == 24);
+        assert(std::abs(gilgit.rain - 1.5) < 1e-9);
+        assert(mapped.autocomplete("dera")[0] == "Dera Ghazi Khan");
+        std::remove(csvPath.c_str());
+    }
+
+    {
+        const std::string snapshotPath = "weather_engine_tests.snap";
+        std::string error;
+        assert(EngineSnapshot::save(engine, snapshotPath, &error));
+
+        WeatherEngine restored;
+        assert(EngineSnapshot::load(restored, snapshotPath, &error));
+        City restoredLahore;
+        assert(restored.getCity("Lahore", restoredLahore));
+        assert(restoredLahore.hourlyData == lahore.hourlyData);
+        assert(restoredLahore.tenDayForecast.size() == 10);
+        assert(restoredLahore.tenDayForecast[3].condition == lahore.tenDayForecast[3].condition);
+        assert(restored.getNeighbors("Islamabad").size() == 4);
+        assert(restored.autocomplete("is") == engine.autocomplete("is"));
+        RouteResult restoredSafest = restored.safestRouteDijkstra("Topi", "Karachi");
+        assert(restoredSafest.path == safest.path);
+        assert(restoredSafest.totalRisk == safest.totalRisk);
+        std::vector<ReachableCity> restoredReach;
+        assert(restored.reachableCities("Topi", safest.totalRisk, 1e9, restoredReach));
+        assert(restoredReach.back().city->name == "Karachi" && restoredReach.back().risk == safest.totalRisk);
+        assert(restored.getTopAlerts(1)[0].severity == 9);
+        assert(!EngineSnapshot::load(restored, snapshotPath, &error));
+        assert(error == "snapshot can only be loaded into an empty engine");
+        assert(restored.autocomplete("is") == engine.autocomplete("is") && restored.getNeighbors("Islamabad").size() == 4);
+
+        // Tries that pass the checksum but are not trees must still be refused.
+        std::ifstream saved(snapshotPath, std::ios::binary);
+        const std::string bytes((std::istreambuf_iterator<char>(saved)), std::istreambuf_iterator<char>());
+        saved.close();
+        using namespace snapshot_format;
+        const SectionEntry* sections = reinterpret_cast<const SectionEntry*>(bytes.data() + sizeof(SnapshotHeader));
+        size_t childOffset = 0;
+        for (uint32_t i = 0; i < SectionCount; i++) {
+            if (sections[i].id == TrieChildren) childOffset = sections[i].offset;
+        }
+        assert(childOffset > 0);
+        for (int tamper = 0; tamper < 2; tamper++) {
+            std::string broken = bytes;
+            TrieChildRecord children[2];
+            std::memcpy(children, &broken[childOffset], sizeof(children));
+            if (tamper == 0) children[1].ch = children[0].ch;
+            if (tamper == 1) children[1].node = children[0].node;
+            std::memcpy(&broken[childOffset], children, sizeof(children));
+            SnapshotHeader header;
+            std::memcpy(&header, broken.data(), sizeof(header));
+            header.checksum = checksum(broken.data() + sizeof(header), broken.size() - sizeof(header));
+            std::memcpy(&broken[0], &header, sizeof(header));
+            std::ofstream(snapshotPath, std::ios::binary | std::ios::trunc) << broken;
+            WeatherEngine refused;
+            assert(!EngineSnapshot::load(refused, snapshotPath, &error));
+            assert(error == "snapshot trie is corrupt");
+        }
+        std::ofstream(snapshotPath, std::ios::binary | std::ios::trunc) << bytes;
+
+        std::fstream corrupt(snapshotPath, std::ios::in | std::ios::out | std::ios::binary);
+        corrupt.seekp(200);
+        corrupt.put('\x7f');
+        corrupt.close();
+        WeatherEngine rejected;
+        assert(!EngineSnapshot::load(rejected, snapshotPath, &error));
+        assert(error == "snapshot checksum mismatch");
+        std::remove(snapshotPath.c_str());
+    }
+
+    {
+        SnapshotCell<std::string> cell;
+        cell.publish(std::make_shared<const std::string>("v1"));
+        std::shared_ptr<const std::string> pinned = cell.acquire();
+        assert(*pinned == "v1");
+        cell.publish(std::make_shared<const std::string>("v2"));
+        assert(*pinned == "v1");
+        assert(*cell.acquire() == "v2");
+        assert(cell.generation() == 2);
+        SnapshotCell<std::string>::Versioned versioned = cell.acquireVersioned();
+        assert(*versioned.value == "v2" && versioned.generation == 2);
+        cell.publish(std::make_shared<const std::string>("v3"));
+        assert(*versioned.value == "v2" && cell.acquireVersioned().generation == 3);
+        SnapshotCell<std::string> unpublished;
+        assert(!unpublished.acquire() && unpublished.acquireVersioned().generation == 0);
+    }
+
+    {
+        RequestArena::Scope arena;
+        QueryParams params = SimpleServer::parseQuery("/api/route?from=New%20York&to=Lahore&to=Karachi&q=100%&x",
+                                                      arena.resource());
+        assert(params.at("from") == "New York");
+        assert(params.at("to") == "Karachi");
+        assert(params.at("q") == "100%");
+        assert(!params.count("x"));
+        assert(params.get_allocator().resource() == arena.resource());
+        assert(SimpleServer::urlDecode("a+b%2Fc%zz") == "a b/c%zz");
+
+        std::pmr::vector<const City*> hottest = engine.hottestCities(3, arena.resource());
+        std::vector<const City*> heap = engine.hottestCities(3);
+        assert(std::equal(hottest.begin(), hottest.end(), heap.begin(), heap.end()));
+        assert(engine.hasCity(std::string_view("  LAHORE  ")));
+    }
+
+    {
+        std::vector<int32_t> values;
+        for (int i = 0; i < 37; i++) values.push_back((i * 7919) % 113 - 40);
+        SeriesReduction simd;
+        SeriesReduction scalar;
+        SeriesKernels::reduce(values.data(), values.size(), simd);
+        SeriesKernels::reduceScalar(values.data(), values.size(), scalar);
+        assert(simd.min == scalar.min && simd.max == scalar.max);
+        assert(simd.sum == scalar.sum && simd.count == 37);
+
+        std::vector<City> cities = engine.getAllCities();
+        const SeriesStore& store = engine.series();
+        assert(store.cityCount() == cities.size());
+        assert(store.value(SeriesKind::Monthly, 17, lahore.id) == lahore.monthlyData[17]);
+
+        int hottestNoon = cities[0].hourlyData[12];
+        double noonSum = 0;
+        for (const City& city : cities) {
+            hottestNoon = std::max(hottestNoon, city.hourlyData[12]);
+            noonSum += city.hourlyData[12];
+        }
+        SeriesStats noon = engine.seriesStats(SeriesKind::Hourly, 12, 13, 1, {0, 100});
+        assert(noon.samples == cities.size());
+        assert(noon.max == hottestNoon);
+        assert(std::abs(noon.mean - noonSum / cities.size()) < 1e-9);
+        assert(noon.percentiles[1].second == hottestNoon);
+
+        double smoothedMax = -1e9;
+        for (const City& city : cities) {
+            for (size_t day = 2; day < 7; day++) {
+                double sum = city.weeklyData[day] + city.weeklyData[day - 1] + city.weeklyData[day - 2];
+                smoothedMax = std::max(smoothedMax, sum / 3.0);
+            }
+        }
+        SeriesStats weekly = engine.seriesStats(SeriesKind::Weekly, 0, 7, 3);
+        assert(weekly.fromSlot == 2 && weekly.slotMeans.size() == 5);
+        assert(std::abs(weekly.max - smoothedMax) < 1e-9);
+        assert(weekly.samples == cities.size() * 5);
+    }
+
+    {
+        WeatherEngine lazy;
+        buildEngine(lazy);
+        lazy.setDerivedCacheCapacity(2);
+        std::vector<City> copies = lazy.getAllCities();
+        assert(copies[0].hourlyData.size() == 24 && copies[0].tenDayForecast.size() == 10 && lazy.derivedCacheSize() == 0);
+        assert(lazy.getColdestCities(1)[0].yearlyData.size() == 12 && lazy.derivedCacheSize() == 1);
+        uint64_t hits = Metrics::engineTotal(EngineCounter::CacheHits);
+        City first;
+        City again;
+        assert(lazy.getCity("Lahore", first));
+        assert(lazy.getCity("Lahore", again));
+        assert(Metrics::engineTotal(EngineCounter::CacheHits) == hits + 1);
+        assert(first.hourlyData == lahore.hourlyData && again.tenDayForecast.size() == 10);
+        City other;
+        assert(lazy.getCity("Karachi", other) && lazy.getCity("Quetta", other));
+        assert(lazy.derivedCacheSize() == 2);
+
+        City custom = lahore;
+        custom.name = "Custom Town";
+        custom.hourlyData = std::vector<int>(24, 1);
+        custom.weeklyData.clear();
+        lazy.addCity(custom);
+        assert(lazy.findCity("Custom Town")->weeklyData.empty());
+        City stored;
+        assert(lazy.getCity("custom town", stored));
+        assert(stored.hourlyData[5] == 1 && stored.weeklyData.size() == 7 && stored.weeklyData == lahore.weeklyData);
+
+        const City* record = lazy.findCity("LAHORE");
+        assert(record && record == lazy.findCity("lahore") && !lazy.findCity("Atlantis"));
+        CityView view = lazy.viewCity("Lahore");
+        assert(view && &view.city() == record && record->hourlyData.empty());
+        assert(view.series(SeriesKind::Hourly) == lahore.hourlyData && view.forecast().size() == 10);
+        CityView explicitView = lazy.viewCity("Custom Town");
+        assert(&explicitView.series(SeriesKind::Hourly) == &explicitView.city().hourlyData);
+        assert(!lazy.viewCity("Atlantis"));
+
+        const std::vector<const City*>& byName = lazy.citiesByName();
+        assert(byName.size() == lazy.getAllCities().size() && byName.back()->name == "Topi");
+        assert(std::is_sorted(byName.begin(), byName.end(), [](const City* a, const City* b) { return a->name < b->name; }));
+        std::vector<const City*> hot = lazy.hottestCities(100);
+        std::vector<const City*> cold = lazy.coldestCities(2);
+        assert(hot.size() == byName.size() && hot.front()->temp >= hot.back()->temp);
+        assert(cold.size() == 2 && cold[0]->temp <= cold[1]->temp && cold[0]->temp == hot.back()->temp);
+        assert(lazy.neighborsOf("Lahore").size() == lazy.getNeighbors("Lahore").size());
+        assert(lazy.neighborsOf("Atlantis").empty());
+    }
+
+    {
+        assert(ObservationHistory::monthIndex(0) == 0);
+        assert(ObservationHistory::monthIndex(1709164800) == 54 * 12 + 1);  // 2024-02-29
+        assert(ObservationHistory::monthIndex(-1) == -1);
+
+        ObservationStore store(4);
+        const int64_t start = 1704067200;  // 2024-01-01 00:00 UTC
+        for (int hour = 0; hour < 50; hour++) {
+            assert(store.append("Lahore", start + hour * 3600, 10 + hour % 5));
+            assert(store.append("lahore ", start + hour * 3600 + 1800, 20 + hour % 5));
+        }
+        std::string error;
+        assert(!store.append("Lahore", start, 0, &error) && !error.empty());
+        assert(store.pointCount("LAHORE") == 100);
+        assert(!store.append("Hunza", -1, 0) && !store.append("Hunza", ObservationHistory::maxTime + 1, 0));
+        ObservedWindows none;
+        assert(store.pointCount("Hunza") == 0 && !store.windows("Hunza", none));
+        ObservationStore capped(4, 3);
+        for (int i = 0; i < 3; i++) assert(capped.append("Lahore", start + i, i));
+        assert(!capped.append("Lahore", start + 3, 3) && capped.pointCount("Lahore") == capped.pointLimit());
+
+        std::vector<Observation> window = store.range("Lahore", start + 3600, start + 3 * 3600);
+        assert(window.size() == 4);
+        assert(window[0].time == start + 3600 && window[0].temp == 11);
+        assert(window[3].time == start + 2 * 3600 + 1800 && window[3].temp == 22);
+
+        std::vector<RollupBucket> days = store.rollup("Lahore", Rollup::Day, 7);
+        assert(days.size() == 7 && days[0].count == 0 && days[3].count == 0);
+        assert(days[4].count == 48 && days[6].count == 4 && days[6].start == start / 86400 + 2);
+        assert(days[4].min == 10 && days[4].max == 24);
+
+        ObservedWindows dense;
+        assert(store.windows("Lahore", dense) && dense.newestTime == start + 49 * 3600 + 1800);
+        assert(dense.hourly.size() == 24 && dense.hourly.back().count == 2 && dense.hourly.back().mean() == 19);
+        assert(dense.weekly.size() == 7 && dense.monthly.size() == 30 && dense.yearly.size() == 12);
+        assert(dense.weekly[0].count == 0 && dense.weekly[4].count == 48 && dense.yearly[11].count == 100);
+
+        // A gap in the history stays a gap: the windows end at the newest
+        // point, not at the newest buckets that happen to exist.
+        assert(store.append("Multan", start, 30));
+        assert(store.append("Multan", start + 60 * 86400, 40));
+        ObservedWindows sparse;
+        assert(store.windows("Multan", sparse) && sparse.newestTime == start + 60 * 86400);
+        assert(sparse.weekly.size() == 7 && sparse.weekly[6].count == 1);
+        for (size_t i = 0; i < 6; i++) assert(sparse.weekly[i].count == 0);
+        assert(sparse.yearly.size() == 12 && sparse.yearly[9].count == 1 && sparse.yearly[11].count == 1);
+
+        const std::string historyPath = "weather_engine_tests_history.csv";
+        std::ofstream(historyPath) << "City,Timestamp,Temp\n\"Quetta\", 1704067200 ,+5\nQuetta,soon,6\nQuetta,1704070800\n";
+        CsvLoadReport report;
+        assert(store.loadCsv(historyPath, report));
+        assert(report.rowsLoaded == 1 && report.errors.size() == 2);
+        assert(report.errors[0].line == 3 && report.errors[1].message == "expected 3 columns, found 2");
+        assert(store.pointCount("quetta") == 1);
+        std::remove(historyPath.c_str());
+        assert(!store.windows("Karachi", none));
+    }
+
+    {
+        std::vector<NearbyCity> near = engine.nearestCities(lahore.lat + 0.01, lahore.lon, 3);
+        assert(near.size() == 3 && near[0].city->name == "Lahore");
+        assert(near[0].distanceKm < 2.0 && near[1].distanceKm <= near[2].distanceKm);
+        size_t total = 0;
+        std::vector<const City*> punjab = engine.citiesInBox(29.0, 33.0, 71.0, 75.0, 2, &total);
+        assert(total >= 3 && punjab.size() == 2 && punjab[0]->name < punjab[1]->name);
+
+        WeatherEngine added;
+        for (int i = 0; i < 4; i++) {
+            City city = lahore;
+            city.name = "Added " + std::to_string(i);
+            city.lat = 10.0 * i;
+            city.temp = 20 + i;
+            added.addCity(city);
+        }
+        assert(added.nearestCities(30.1, lahore.lon, 1)[0].city->name == "Added 3");
+        assert(added.hottestCities(1)[0]->name == "Added 3" && added.citiesByName().size() == 4);
+        City late = lahore;
+        late.name = "Added 4";
+        late.temp = 60;
+        added.addCity(late);
+        assert(added.hottestCities(1)[0]->name == "Added 4" && added.citiesInBox(-1.0, 1.0, 70.0, 80.0, 5).size() == 1);
+
+        std::mt19937_64 rng(3);
+        std::uniform_real_distribution<double> latDist(-90.0, 90.0);
+        std::uniform_real_distribution<double> lonDist(-180.0, 180.0);
+        std::vector<double> lats(3000);
+        std::vector<double> lons(3000);
+        for (size_t i = 0; i < lats.size(); i++) {
+            lats[i] = latDist(rng);
+            lons[i] = lonDist(rng);
+        }
+        SpatialIndex index;
+        index.build(lats, lons);
+        auto greatCircleKm = [&](double lat, double lon, size_t i) {
+            const double rad = 3.14159265358979323846 / 180.0;
+            double h = std::pow(std::sin((lats[i] - lat) * rad / 2), 2) +
+                       std::cos(lat * rad) * std::cos(lats[i] * rad) * std::pow(std::sin((lons[i] - lon) * rad / 2), 2);
+            return 2 * SpatialIndex::earthRadiusKm * std::asin(std::sqrt(h));
+        };
+        for (int q = 0; q < 50; q++) {
+            double lat = latDist(rng);
+            double lon = lonDist(rng);
+            std::vector<double> exact;
+            for (size_t i = 0; i < lats.size(); i++) exact.push_back(greatCircleKm(lat, lon, i));
+            std::sort(exact.begin(), exact.end());
+            std::vector<SpatialIndex::Neighbor> found = index.nearest(lat, lon, 7);
+            assert(found.size() == 7);
+            for (size_t i = 0; i < found.size(); i++) assert(std::abs(found[i].distanceKm - exact[i]) < 1e-6);
+        }
+
+        std::vector<uint32_t> wrapped;
+        index.withinBox(-20.0, 35.0, 150.0, -160.0, wrapped);
+        size_t expected = 0;
+        for (size_t i = 0; i < lats.size(); i++) {
+            if (lats[i] >= -20.0 && lats[i] <= 35.0 && (lons[i] >= 150.0 || lons[i] <= -160.0)) expected++;
+        }
+        assert(expected > 0 && wrapped.size() == expected);
+    }
+
     std::cout << "All WeatherEngine tests passed." << std::endl;
     return 0;
 }